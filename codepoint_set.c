@@ -0,0 +1,423 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "codepoint_set.h"
+
+#define PLANE_COUNT     17
+#define CONTAINER_SIZE  0x10000
+#define ARRAY_MAX       4096 // beyond this an array takes more space than a bitmap
+#define BITMAP_WORDS    (CONTAINER_SIZE / 64)
+
+#define FREE_AND_NULL(mem) (free(mem), (mem) = NULL)
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+enum container_kind {
+	CONTAINER_EMPTY,
+	CONTAINER_ARRAY,
+	CONTAINER_BITMAP,
+	CONTAINER_FULL
+};
+
+typedef struct container {
+	enum container_kind kind;
+	uint32_t cardinality;
+	uint32_t capacity; // of array
+	union {
+		uint16_t * array;
+		uint64_t * bitmap;
+	} u;
+} container;
+
+struct codepoint_set {
+	container planes[PLANE_COUNT];
+};
+
+// CONTAINER FUNCTIONS
+
+static void container_clear (container * c) {
+	if (c->kind == CONTAINER_ARRAY) FREE_AND_NULL(c->u.array);
+	else if (c->kind == CONTAINER_BITMAP) FREE_AND_NULL(c->u.bitmap);
+	c->kind = CONTAINER_EMPTY;
+	c->cardinality = c->capacity = 0;
+}
+
+static void container_set_full (container * c) {
+	container_clear(c);
+	c->kind = CONTAINER_FULL;
+	c->cardinality = CONTAINER_SIZE;
+}
+
+// Returns the number of bits that were not already set.
+static uint32_t bitmap_set_range (uint64_t * words, uint32_t low, uint32_t high) {
+	uint32_t first = low / 64, last = high / 64, added = 0;
+	uint64_t first_mask = ~(uint64_t) 0 << (low % 64),
+		last_mask = ~(uint64_t) 0 >> (63 - high % 64);
+	for (uint32_t i = first; i <= last; ++i) {
+		uint64_t mask = ~(uint64_t) 0;
+		if (i == first) mask &= first_mask;
+		if (i == last) mask &= last_mask;
+		added += __builtin_popcountll(mask & ~words[i]);
+		words[i] |= mask;
+	}
+	return added;
+}
+
+static uint32_t bitmap_count (const uint64_t * words) {
+	uint32_t count = 0;
+	for (int i = 0; i < BITMAP_WORDS; ++i) count += __builtin_popcountll(words[i]);
+	return count;
+}
+
+// Fills words, which has space for BITMAP_WORDS, with the members of c.
+static void container_to_bitmap (const container * c, uint64_t * words) {
+	switch (c->kind) {
+		case CONTAINER_EMPTY:
+			memset(words, 0, BITMAP_WORDS * sizeof *words); break;
+		case CONTAINER_FULL:
+			memset(words, 0xFF, BITMAP_WORDS * sizeof *words); break;
+		case CONTAINER_BITMAP:
+			memcpy(words, c->u.bitmap, BITMAP_WORDS * sizeof *words); break;
+		case CONTAINER_ARRAY:
+			memset(words, 0, BITMAP_WORDS * sizeof *words);
+			for (uint32_t i = 0; i < c->cardinality; ++i)
+				words[c->u.array[i] / 64] |= (uint64_t) 1 << (c->u.array[i] % 64);
+			break;
+	}
+}
+
+// Sets c to the members of words in the most compact representation.
+// c must be empty.
+static bool container_from_bitmap (container * c, const uint64_t * words) {
+	uint32_t count = bitmap_count(words);
+
+	if (count == 0) return true;
+	else if (count == CONTAINER_SIZE) {
+		container_set_full(c); return true;
+	}
+	else if (count <= ARRAY_MAX) {
+		uint16_t * array = malloc(count * sizeof *array);
+		MEM_ERR_RETURN_FALSE(array);
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < BITMAP_WORDS; ++i) {
+			for (uint64_t word = words[i]; word != 0; word &= word - 1)
+				array[n++] = i * 64 + __builtin_ctzll(word);
+		}
+		c->kind = CONTAINER_ARRAY;
+		c->u.array = array;
+		c->capacity = count;
+	}
+	else {
+		uint64_t * bitmap = malloc(BITMAP_WORDS * sizeof *bitmap);
+		MEM_ERR_RETURN_FALSE(bitmap);
+		memcpy(bitmap, words, BITMAP_WORDS * sizeof *bitmap);
+		c->kind = CONTAINER_BITMAP;
+		c->u.bitmap = bitmap;
+	}
+	c->cardinality = count;
+	return true;
+}
+
+static bool container_copy (container * dest, const container * src) {
+	*dest = *src;
+	if (src->kind == CONTAINER_ARRAY) {
+		dest->u.array = malloc(src->capacity * sizeof *dest->u.array);
+		MEM_ERR_RETURN_FALSE(dest->u.array);
+		memcpy(dest->u.array, src->u.array, src->cardinality * sizeof *dest->u.array);
+	}
+	else if (src->kind == CONTAINER_BITMAP) {
+		dest->u.bitmap = malloc(BITMAP_WORDS * sizeof *dest->u.bitmap);
+		MEM_ERR_RETURN_FALSE(dest->u.bitmap);
+		memcpy(dest->u.bitmap, src->u.bitmap, BITMAP_WORDS * sizeof *dest->u.bitmap);
+	}
+	return true;
+}
+
+static bool container_add_range (container * c, uint32_t low, uint32_t high) {
+	uint32_t n = high - low + 1;
+
+	if (c->kind == CONTAINER_FULL) return true;
+	else if (n == CONTAINER_SIZE) {
+		container_set_full(c); return true;
+	}
+
+	// Appending to an array, the common case when building from sorted data.
+	if ((c->kind == CONTAINER_EMPTY
+			|| (c->kind == CONTAINER_ARRAY && c->u.array[c->cardinality - 1] < low))
+			&& c->cardinality + n <= ARRAY_MAX) {
+		if (c->cardinality + n > c->capacity) {
+			uint32_t capacity = c->capacity == 0 ? 16 : c->capacity;
+			while (capacity < c->cardinality + n) capacity *= 2;
+			if (capacity > ARRAY_MAX) capacity = ARRAY_MAX;
+			uint16_t * array = realloc(c->u.array, capacity * sizeof *array);
+			MEM_ERR_RETURN_FALSE(array);
+			c->u.array = array;
+			c->capacity = capacity;
+		}
+		for (uint32_t cp = low; cp <= high; ++cp)
+			c->u.array[c->cardinality++] = cp;
+		c->kind = CONTAINER_ARRAY;
+		return true;
+	}
+
+	if (c->kind != CONTAINER_BITMAP) {
+		uint64_t * bitmap = malloc(BITMAP_WORDS * sizeof *bitmap);
+		MEM_ERR_RETURN_FALSE(bitmap);
+		uint32_t cardinality = c->cardinality;
+		container_to_bitmap(c, bitmap);
+		container_clear(c);
+		c->kind = CONTAINER_BITMAP;
+		c->u.bitmap = bitmap;
+		c->cardinality = cardinality;
+	}
+	c->cardinality += bitmap_set_range(c->u.bitmap, low, high);
+	if (c->cardinality == CONTAINER_SIZE) container_set_full(c);
+
+	return true;
+}
+
+// index of first element >= value, or cardinality
+static uint32_t array_lower_bound (const container * c, uint32_t value) {
+	uint32_t low = 0, high = c->cardinality;
+	while (low < high) {
+		uint32_t mid = low + (high - low) / 2;
+		if (c->u.array[mid] < value) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+static bool container_contains (const container * c, uint32_t value) {
+	switch (c->kind) {
+		case CONTAINER_EMPTY: return false;
+		case CONTAINER_FULL: return true;
+		case CONTAINER_BITMAP:
+			return c->u.bitmap[value / 64] >> (value % 64) & 1;
+		case CONTAINER_ARRAY: {
+			uint32_t i = array_lower_bound(c, value);
+			return i < c->cardinality && c->u.array[i] == value;
+		}
+	}
+	return false;
+}
+
+// first member >= from, or CONTAINER_SIZE
+static uint32_t container_next (const container * c, uint32_t from) {
+	switch (c->kind) {
+		case CONTAINER_EMPTY: return CONTAINER_SIZE;
+		case CONTAINER_FULL: return from;
+		case CONTAINER_ARRAY: {
+			uint32_t i = array_lower_bound(c, from);
+			return i < c->cardinality ? c->u.array[i] : CONTAINER_SIZE;
+		}
+		case CONTAINER_BITMAP: {
+			uint32_t i = from / 64;
+			uint64_t word = c->u.bitmap[i] & ~(uint64_t) 0 << (from % 64);
+			while (word == 0) {
+				if (++i == BITMAP_WORDS) return CONTAINER_SIZE;
+				word = c->u.bitmap[i];
+			}
+			return i * 64 + __builtin_ctzll(word);
+		}
+	}
+	return CONTAINER_SIZE;
+}
+
+// first non-member >= from, where from is a member, or CONTAINER_SIZE
+static uint32_t container_next_absent (const container * c, uint32_t from) {
+	switch (c->kind) {
+		case CONTAINER_EMPTY: return from;
+		case CONTAINER_FULL: return CONTAINER_SIZE;
+		case CONTAINER_ARRAY: {
+			uint32_t i = array_lower_bound(c, from);
+			while (i + 1 < c->cardinality && c->u.array[i + 1] == c->u.array[i] + 1) ++i;
+			return c->u.array[i] + 1;
+		}
+		case CONTAINER_BITMAP: {
+			uint32_t i = from / 64;
+			uint64_t word = ~c->u.bitmap[i] & ~(uint64_t) 0 << (from % 64);
+			while (word == 0) {
+				if (++i == BITMAP_WORDS) return CONTAINER_SIZE;
+				word = ~c->u.bitmap[i];
+			}
+			return i * 64 + __builtin_ctzll(word);
+		}
+	}
+	return CONTAINER_SIZE;
+}
+
+// Sorted merge of two arrays; the result must be empty.
+static bool array_merge (container * result, const container * a,
+						 const container * b, bool intersect) {
+	uint32_t max = intersect ? MIN(a->cardinality, b->cardinality)
+		: a->cardinality + b->cardinality;
+	uint32_t i = 0, j = 0, n = 0;
+	uint16_t * array = malloc(max * sizeof *array);
+	MEM_ERR_RETURN_FALSE(array);
+
+	while (i < a->cardinality && j < b->cardinality) {
+		uint16_t x = a->u.array[i], y = b->u.array[j];
+		if (x == y) array[n++] = x, ++i, ++j;
+		else if (x < y) { if (!intersect) array[n++] = x; ++i; }
+		else { if (!intersect) array[n++] = y; ++j; }
+	}
+	if (!intersect) {
+		while (i < a->cardinality) array[n++] = a->u.array[i++];
+		while (j < b->cardinality) array[n++] = b->u.array[j++];
+	}
+
+	if (n == 0) free(array);
+	else {
+		result->kind = CONTAINER_ARRAY;
+		result->u.array = array;
+		result->cardinality = n;
+		result->capacity = max;
+	}
+	return true;
+}
+
+enum set_operation { SET_AND, SET_OR, SET_NOT };
+
+static bool container_operate (container * result, const container * a,
+							   const container * b, enum set_operation op) {
+	uint64_t words[BITMAP_WORDS], other[BITMAP_WORDS];
+
+	switch (op) {
+		case SET_AND:
+			if (a->kind == CONTAINER_EMPTY || b->kind == CONTAINER_EMPTY) return true;
+			else if (a->kind == CONTAINER_FULL) return container_copy(result, b);
+			else if (b->kind == CONTAINER_FULL) return container_copy(result, a);
+			else if (a->kind == CONTAINER_ARRAY && b->kind == CONTAINER_ARRAY)
+				return array_merge(result, a, b, true);
+			break;
+		case SET_OR:
+			if (a->kind == CONTAINER_FULL || b->kind == CONTAINER_FULL) {
+				container_set_full(result); return true;
+			}
+			else if (a->kind == CONTAINER_EMPTY) return container_copy(result, b);
+			else if (b->kind == CONTAINER_EMPTY) return container_copy(result, a);
+			else if (a->kind == CONTAINER_ARRAY && b->kind == CONTAINER_ARRAY
+					&& a->cardinality + b->cardinality <= ARRAY_MAX)
+				return array_merge(result, a, b, false);
+			break;
+		case SET_NOT:
+			if (a->kind == CONTAINER_EMPTY) container_set_full(result);
+			else if (a->kind != CONTAINER_FULL) break;
+			return true;
+	}
+
+	container_to_bitmap(a, words);
+	if (op == SET_NOT)
+		for (int i = 0; i < BITMAP_WORDS; ++i) words[i] = ~words[i];
+	else {
+		container_to_bitmap(b, other);
+		for (int i = 0; i < BITMAP_WORDS; ++i)
+			words[i] = op == SET_AND ? words[i] & other[i] : words[i] | other[i];
+	}
+	return container_from_bitmap(result, words);
+}
+
+// END CONTAINER FUNCTIONS
+
+codepoint_set * codepoint_set_new () {
+	codepoint_set * set = calloc(1, sizeof *set);
+	MEM_ERR_RETURN_NULL(set);
+	return set;
+}
+
+void codepoint_set_free (codepoint_set * * set) {
+	if (*set != NULL) {
+		for (int i = 0; i < PLANE_COUNT; ++i)
+			container_clear(&(*set)->planes[i]);
+		FREE_AND_NULL(*set);
+	}
+}
+
+codepoint_set * codepoint_set_copy (const codepoint_set * set) {
+	codepoint_set * copy = codepoint_set_new();
+	if (copy == NULL) return NULL;
+	for (int i = 0; i < PLANE_COUNT; ++i) {
+		if (!container_copy(&copy->planes[i], &set->planes[i])) {
+			codepoint_set_free(&copy); return NULL;
+		}
+	}
+	return copy;
+}
+
+bool codepoint_set_add_range (codepoint_set * set, unichar low, unichar high) {
+	if (!CODEPOINT_VALID(low) || !CODEPOINT_VALID(high) || low > high)
+		return false;
+
+	for (unichar plane = low >> 16; plane <= high >> 16; ++plane) {
+		uint32_t first = plane == low >> 16 ? low & 0xFFFF : 0,
+			last = plane == high >> 16 ? high & 0xFFFF : 0xFFFF;
+		if (!container_add_range(&set->planes[plane], first, last))
+			return false;
+	}
+	return true;
+}
+
+bool codepoint_set_contains (const codepoint_set * set, unichar codepoint) {
+	return CODEPOINT_VALID(codepoint)
+		&& container_contains(&set->planes[codepoint >> 16], codepoint & 0xFFFF);
+}
+
+size_t codepoint_set_count (const codepoint_set * set) {
+	size_t count = 0;
+	for (int i = 0; i < PLANE_COUNT; ++i) count += set->planes[i].cardinality;
+	return count;
+}
+
+static codepoint_set * codepoint_set_operate (const codepoint_set * a,
+											  const codepoint_set * b,
+											  enum set_operation op) {
+	codepoint_set * result = codepoint_set_new();
+	if (result == NULL) return NULL;
+	for (int i = 0; i < PLANE_COUNT; ++i) {
+		if (!container_operate(&result->planes[i], &a->planes[i],
+				b != NULL ? &b->planes[i] : NULL, op)) {
+			codepoint_set_free(&result); return NULL;
+		}
+	}
+	return result;
+}
+
+codepoint_set * codepoint_set_and (const codepoint_set * a, const codepoint_set * b) {
+	return codepoint_set_operate(a, b, SET_AND);
+}
+
+codepoint_set * codepoint_set_or (const codepoint_set * a, const codepoint_set * b) {
+	return codepoint_set_operate(a, b, SET_OR);
+}
+
+codepoint_set * codepoint_set_not (const codepoint_set * set) {
+	return codepoint_set_operate(set, NULL, SET_NOT);
+}
+
+void codepoint_set_fill_bitmap (const codepoint_set * set, uint64_t * words) {
+	for (int i = 0; i < PLANE_COUNT; ++i)
+		container_to_bitmap(&set->planes[i], words + i * BITMAP_WORDS);
+}
+
+bool codepoint_set_next_range (const codepoint_set * set, unichar from,
+							   unichar * low, unichar * high) {
+	unichar plane = from >> 16;
+	uint32_t next = CONTAINER_SIZE;
+
+	for (uint32_t pos = from & 0xFFFF; plane < PLANE_COUNT; ++plane, pos = 0)
+		if ((next = container_next(&set->planes[plane], pos)) < CONTAINER_SIZE)
+			break;
+	if (plane >= PLANE_COUNT) return false;
+
+	*low = plane << 16 | next;
+
+	// A run can continue into the following planes.
+	while ((next = container_next_absent(&set->planes[plane], next)) == CONTAINER_SIZE
+			&& plane + 1 < PLANE_COUNT
+			&& container_contains(&set->planes[plane + 1], 0))
+		++plane, next = 0;
+
+	*high = (plane << 16) + next - 1;
+	return true;
+}
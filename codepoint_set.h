@@ -0,0 +1,53 @@
+#ifndef CODEPOINT_SET_H
+#define CODEPOINT_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "unicodename.h"
+
+// Set of code points U+0000-U+10FFFF, stored roaring-style: each plane of
+// 0x10000 code points is a container that is empty, full, a sorted array
+// of the low 16 bits of its members (up to 4096 of them), or a bitmap.
+typedef struct codepoint_set codepoint_set;
+
+// return newly allocated empty set
+codepoint_set * codepoint_set_new (void);
+
+void codepoint_set_free (codepoint_set * * set);
+
+codepoint_set * codepoint_set_copy (const codepoint_set * set);
+
+// Adds low-high inclusive. Adding in ascending order is fastest.
+bool codepoint_set_add_range (codepoint_set * set, unichar low, unichar high);
+
+#define codepoint_set_add(set, codepoint) \
+	codepoint_set_add_range((set), (codepoint), (codepoint))
+
+bool codepoint_set_contains (const codepoint_set * set, unichar codepoint);
+
+size_t codepoint_set_count (const codepoint_set * set);
+
+// Return a newly allocated set; the operands are not modified.
+codepoint_set * codepoint_set_and (const codepoint_set * a, const codepoint_set * b);
+codepoint_set * codepoint_set_or (const codepoint_set * a, const codepoint_set * b);
+// complement within U+0000-U+10FFFF
+codepoint_set * codepoint_set_not (const codepoint_set * set);
+
+// Number of 64-bit words in a flat bitmap of the whole code space.
+#define CODEPOINT_BITMAP_WORDS (0x110000 / 64)
+#define CODEPOINT_BITMAP_TEST(words, codepoint) \
+	((words)[(codepoint) / 64] >> ((codepoint) % 64) & 1)
+
+// Fills words, which has space for CODEPOINT_BITMAP_WORDS, with a flat
+// bitmap of the set, for lookups that must cost a single memory read.
+void codepoint_set_fill_bitmap (const codepoint_set * set, uint64_t * words);
+
+// Finds the first run of consecutive members at or after from.
+// Returns false if there are none.
+// To iterate: for (cp = 0; cp <= 0x10FFFF && next_range(set, cp, &low, &high); cp = high + 1)
+bool codepoint_set_next_range (const codepoint_set * set, unichar from,
+							   unichar * low, unichar * high);
+
+#endif
@@ -10,6 +10,7 @@
 
 #define MEM_ERR "Not enough memory"
 #define MEM_ERR_RETURN_NULL(pointer) if (pointer == NULL) { perror(MEM_ERR); return NULL; }
+#define MEM_ERR_RETURN_FALSE(pointer) if (pointer == NULL) { perror(MEM_ERR); return false; }
 
 #define BETWEEN(x, a, b) ((a) <= (x) && (x) <= (b))
 
@@ -0,0 +1,254 @@
+/*
+ *  Expands \N{NAME} escapes in text, and replaces characters with them.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "escape.h"
+#include "utf8.h"
+#include "query.h"
+#include "codepoint_set.h"
+#include "subset.h"
+
+#define ESCAPE_BUF_SIZE (1 << 16)
+
+// Direct-mapped cache of the escapes of recently seen code points.
+#define NAME_CACHE_SIZE 1024
+#define ESCAPE_MAX_LEN (UCD_NAME_BUF_LEN + sizeof "\\N{}")
+
+#define ESCAPE_START       "\\N{"
+#define ESCAPE_START_LEN   (sizeof ESCAPE_START - 1)
+#define ESCAPED_BACKSLASH  "\\N{U+005C}"
+
+#define NON_ASCII_QUERY     "!0..7F"
+#define NON_PRINTABLE_QUERY "(gc=C | gc=Z) & !(U+0020 | U+0009 | U+000A | U+000D)"
+
+// EXPANDING
+
+enum expand_state {
+	EXPAND_TEXT,
+	EXPAND_BACKSLASH, // after "\"
+	EXPAND_N,         // after "\N"
+	EXPAND_NAME       // after "\N{"
+};
+
+typedef struct expander {
+	FILE * out;
+	const name_hash * names;
+	enum expand_state state;
+	char name[UCD_NAME_BUF_LEN];
+	size_t name_len;
+} expander;
+
+// Writes what has been read of an escape that turned out not to be one.
+static void expander_flush (expander * e) {
+	switch (e->state) {
+		case EXPAND_TEXT: break;
+		case EXPAND_BACKSLASH: fputc('\\', e->out); break;
+		case EXPAND_N: fputs("\\N", e->out); break;
+		case EXPAND_NAME:
+			fprintf(e->out, "\\N{%.*s", (int) e->name_len, e->name); break;
+	}
+	e->state = EXPAND_TEXT;
+}
+
+static void expander_finish_name (expander * e) {
+	unichar codepoint;
+	unsigned char encoded[UTF8_MAX_LEN];
+	size_t len;
+
+	e->name[e->name_len] = '\0';
+	if (name_hash_find(e->names, e->name, &codepoint)
+			&& (len = utf8_encode(codepoint, encoded)) > 0)
+		fwrite(encoded, 1, len, e->out);
+	else {
+		fprintf(stderr, "Unknown character name: %s\n", e->name);
+		fprintf(e->out, "\\N{%s}", e->name);
+	}
+	e->state = EXPAND_TEXT;
+}
+
+// Returns false if c must be processed again in the text state.
+static bool expander_step (expander * e, char c) {
+	switch (e->state) {
+		case EXPAND_TEXT:
+			if (c == '\\') e->state = EXPAND_BACKSLASH;
+			else fputc(c, e->out);
+			return true;
+		case EXPAND_BACKSLASH:
+			if (c == 'N') { e->state = EXPAND_N; return true; }
+			break;
+		case EXPAND_N:
+			if (c == '{') {
+				e->state = EXPAND_NAME, e->name_len = 0; return true;
+			}
+			break;
+		case EXPAND_NAME:
+			if (c == '}') { expander_finish_name(e); return true; }
+			else if (c != '\n' && e->name_len < sizeof e->name - 1) {
+				e->name[e->name_len++] = c; return true;
+			}
+			break;
+	}
+	expander_flush(e);
+	return false;
+}
+
+bool escape_expand (FILE * in, FILE * out, const name_hash * names) {
+	static char buf[ESCAPE_BUF_SIZE];
+	expander e = { out, names, EXPAND_TEXT, "", 0 };
+	size_t len;
+
+	while ((len = fread(buf, 1, sizeof buf, in)) > 0) {
+		for (size_t i = 0; i < len; ) {
+			// Copy text up to the next backslash in one go.
+			if (e.state == EXPAND_TEXT) {
+				const char * backslash = memchr(buf + i, '\\', len - i);
+				size_t text_len = backslash != NULL ? (size_t) (backslash - (buf + i)) : len - i;
+				fwrite(buf + i, 1, text_len, out);
+				i += text_len;
+				if (i == len) break;
+			}
+			if (expander_step(&e, buf[i])) ++i;
+		}
+	}
+	expander_flush(&e);
+
+	return !ferror(in) && !ferror(out);
+}
+
+// END EXPANDING
+
+// ESCAPING
+
+typedef struct name_cache_entry {
+	unichar codepoint;
+	size_t len;
+	char escape[ESCAPE_MAX_LEN];
+} name_cache_entry;
+
+static size_t format_escape (const ucd_index * index, unichar codepoint, char * out) {
+	char buf[UCD_NAME_BUF_LEN];
+	const char * name = ucd_index_name(index, codepoint, buf), * aliases;
+	int name_len = name != NULL ? strlen(name) : 0;
+
+	if ((name == NULL || name[0] == '<')
+			&& (aliases = ucd_index_aliases(index, codepoint)) != NULL) {
+		const char * end = strstr(aliases, ", ");
+		name = aliases;
+		name_len = end != NULL ? end - aliases : strlen(aliases);
+	}
+
+	int len = name != NULL && name[0] != '<'
+		? snprintf(out, ESCAPE_MAX_LEN, "\\N{%.*s}", name_len, name)
+		: snprintf(out, ESCAPE_MAX_LEN, "\\N{U+%04X}", codepoint);
+	return len > 0 && len < ESCAPE_MAX_LEN ? len : 0;
+}
+
+static void write_escape (const ucd_index * index, name_cache_entry * cache,
+						  unichar codepoint, FILE * out) {
+	name_cache_entry * entry = &cache[codepoint % NAME_CACHE_SIZE];
+	if (entry->codepoint != codepoint) {
+		entry->codepoint = codepoint;
+		entry->len = format_escape(index, codepoint, entry->escape);
+	}
+	fwrite(entry->escape, 1, entry->len, out);
+}
+
+static uint64_t * escape_bitmap (const ucd_index * index, enum escape_which which) {
+	codepoint_set * set = query_evaluate(index,
+		which == ESCAPE_NON_ASCII ? NON_ASCII_QUERY : NON_PRINTABLE_QUERY);
+	if (set == NULL) return NULL;
+
+#ifdef UCD_SUBSET
+	// Queries only return code points in the subset. Nothing is known about
+	// the other characters, so the non-ASCII ones are escaped as \N{U+XXXX}.
+	codepoint_set * outside = codepoint_set_not(index->subset), * non_ascii = NULL,
+		* escaped = NULL;
+	if (outside != NULL && (non_ascii = codepoint_set_new()) != NULL
+			&& codepoint_set_add_range(non_ascii, 0x80, 0x10FFFF)) {
+		codepoint_set * outside_non_ascii = codepoint_set_and(outside, non_ascii);
+		if (outside_non_ascii != NULL) escaped = codepoint_set_or(set, outside_non_ascii);
+		codepoint_set_free(&outside_non_ascii);
+	}
+	codepoint_set_free(&outside), codepoint_set_free(&non_ascii), codepoint_set_free(&set);
+	if ((set = escaped) == NULL) return NULL;
+#endif
+
+	uint64_t * bitmap = malloc(CODEPOINT_BITMAP_WORDS * sizeof *bitmap);
+	if (bitmap != NULL) codepoint_set_fill_bitmap(set, bitmap);
+	else perror(MEM_ERR);
+
+	codepoint_set_free(&set);
+	return bitmap;
+}
+
+bool escape_names (FILE * in, FILE * out, const ucd_index * index,
+				   enum escape_which which) {
+	static unsigned char buf[ESCAPE_BUF_SIZE + UTF8_MAX_LEN];
+	size_t carry = 0;
+
+	uint64_t * bitmap = escape_bitmap(index, which);
+	if (bitmap == NULL) return false;
+	// ASCII can be copied without looking at it unless some of it is escaped.
+	bool skip_ascii = (bitmap[0] | bitmap[1]) == 0;
+
+	name_cache_entry * cache = malloc(NAME_CACHE_SIZE * sizeof *cache);
+	if (cache == NULL) {
+		perror(MEM_ERR); free(bitmap); return false;
+	}
+	for (int i = 0; i < NAME_CACHE_SIZE; ++i) cache[i].codepoint = UTF8_INVALID;
+
+	while (true) {
+		size_t read = fread(buf + carry, 1, ESCAPE_BUF_SIZE, in);
+		size_t len = carry + read, i = 0;
+		bool at_eof = read == 0;
+
+		if (len == 0) break;
+
+		while (i < len) {
+			if (skip_ascii) {
+				size_t ascii = utf8_ascii_prefix(buf + i, len - i);
+				const unsigned char * backslash = memchr(buf + i, '\\', ascii);
+				size_t text_len = backslash != NULL ? (size_t) (backslash - (buf + i)) : ascii;
+				fwrite(buf + i, 1, text_len, out);
+				if ((i += text_len) == len) break;
+			}
+
+			// A "\N{" in the input would be read as the start of an escape,
+			// so its backslash is escaped.
+			if (buf[i] == '\\') {
+				bool complete = len - i >= ESCAPE_START_LEN;
+				if (!complete && !at_eof) break; // may continue in the next read
+				fputs(complete && memcmp(buf + i, ESCAPE_START, ESCAPE_START_LEN) == 0
+					? ESCAPED_BACKSLASH : "\\", out);
+				++i;
+				continue;
+			}
+
+			unichar codepoint;
+			size_t seq_len = utf8_decode(buf + i, len - i, &codepoint);
+			if (seq_len == 0) { // sequence continues in the next read
+				if (!at_eof) break;
+				codepoint = UTF8_INVALID, seq_len = 1;
+			}
+			if (codepoint != UTF8_INVALID && CODEPOINT_BITMAP_TEST(bitmap, codepoint))
+				write_escape(index, cache, codepoint, out);
+			else
+				fwrite(buf + i, 1, seq_len, out);
+			i += seq_len;
+		}
+
+		carry = len - i;
+		memmove(buf, buf + i, carry);
+		if (at_eof) break;
+	}
+
+	free(cache);
+	free(bitmap);
+	return !ferror(in) && !ferror(out);
+}
+
+// END ESCAPING
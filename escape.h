@@ -0,0 +1,31 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "ucd_index.h"
+#include "name_hash.h"
+
+enum escape_which {
+	ESCAPE_NON_ASCII,    // every character outside U+0000-U+007F
+	ESCAPE_NON_PRINTABLE // controls, format characters, unassigned, private
+	                     // use, and separators other than space, tab, CR, LF
+};
+
+// Copies in to out, replacing each \N{NAME} (name or alias, any case) and
+// \N{U+XXXX} with the character in UTF-8. Everything else, including
+// unknown names, is copied unchanged; unknown names cause a warning.
+// Uses constant memory. Returns false on a read or write error.
+bool escape_expand (FILE * in, FILE * out, const name_hash * names);
+
+// Copies in to out, replacing the characters selected by which with
+// \N{NAME}. Characters whose name is a label use their first alias, or
+// \N{U+XXXX} if they have none. Bytes that are not valid UTF-8 are copied.
+// A "\N{" in the input is written as "\N{U+005C}N{", so that escape_expand
+// gives back the input.
+// Uses constant memory. Returns false on a read or write error.
+bool escape_names (FILE * in, FILE * out, const ucd_index * index,
+				   enum escape_which which);
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ *  Prints how characters decompose.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "common.h"
+#include "explain.h"
+#include "utf8.h"
+
+#define EXPLAIN_BUF_SIZE (1 << 16)
+#define INDENT 2
+
+static void print_name (const ucd_index * index, unichar codepoint, FILE * out) {
+	char buf[UCD_NAME_BUF_LEN];
+	const char * name = ucd_index_name(index, codepoint, buf);
+	if (name != NULL) fprintf(out, "U+%04X %s", codepoint, name);
+	else fprintf(out, "U+%04X <reserved-%04X>", codepoint, codepoint);
+}
+
+// Prints codepoint and, after " = ", its mapping in the format of
+// UnicodeData.txt, then the tree of each code point in the mapping.
+static void explain_node (const ucd_index * index, unichar codepoint, int depth,
+						  FILE * out) {
+	ucd_decomposition decomposition;
+
+	fprintf(out, "%*s", depth * INDENT, "");
+	print_name(index, codepoint, out);
+
+	if (!ucd_index_decomposition(index, codepoint, &decomposition)) {
+		putc('\n', out); return;
+	}
+
+	const char * tag = ucd_decomposition_tag(decomposition.type);
+	fputs(" =", out);
+	if (tag != NULL && tag[0] != '\0') fprintf(out, " <%s>", tag);
+	for (size_t i = 0; i < decomposition.len; ++i)
+		fprintf(out, " %04X", decomposition.codepoints[i]);
+	putc('\n', out);
+
+	// Copied because decomposition may point into its own buffer.
+	unichar parts[UCD_MAX_DECOMPOSITION_LEN];
+	size_t part_count = decomposition.len;
+	memcpy(parts, decomposition.codepoints, part_count * sizeof *parts);
+	for (size_t i = 0; i < part_count; ++i)
+		explain_node(index, parts[i], depth + 1, out);
+}
+
+static void print_full_decomposition (const ucd_index * index, unichar codepoint,
+									  bool compatibility, FILE * out) {
+	ucd_decomposition decomposition;
+
+	fputs(compatibility ? "compatibility:" : "canonical:    ", out);
+	if (ucd_index_full_decomposition(index, codepoint, compatibility, &decomposition))
+		for (size_t i = 0; i < decomposition.len; ++i)
+			fprintf(out, " U+%04X", decomposition.codepoints[i]);
+	else
+		fprintf(out, " U+%04X", codepoint);
+	putc('\n', out);
+}
+
+static void explain_codepoint (const ucd_index * index, unichar codepoint, FILE * out) {
+	explain_node(index, codepoint, 0, out);
+	print_full_decomposition(index, codepoint, false, out);
+	print_full_decomposition(index, codepoint, true, out);
+	putc('\n', out);
+}
+
+// Explains the characters in buf up to the last sequence, which is left
+// if it is incomplete and !at_end. Returns the number of bytes used.
+static size_t explain_buffer (const ucd_index * index, const unsigned char * buf,
+							  size_t len, bool at_end, bool skip_line_breaks,
+							  FILE * out) {
+	size_t i = 0;
+
+	while (i < len) {
+		unichar codepoint;
+		size_t seq_len = utf8_decode(buf + i, len - i, &codepoint);
+		if (seq_len == 0) {
+			if (!at_end) break;
+			codepoint = UTF8_INVALID, seq_len = 1;
+		}
+
+		if (codepoint == UTF8_INVALID)
+			fprintf(out, "Invalid UTF-8 byte 0x%02X\n\n", buf[i]);
+		else if (!(skip_line_breaks && (codepoint == '\n' || codepoint == '\r')))
+			explain_codepoint(index, codepoint, out);
+		i += seq_len;
+	}
+
+	return i;
+}
+
+void explain_text (const ucd_index * index, const char * text, size_t len, FILE * out) {
+	explain_buffer(index, (const unsigned char *) text, len, true, false, out);
+}
+
+bool explain_file (const ucd_index * index, const char * path, FILE * out) {
+	static unsigned char buf[EXPLAIN_BUF_SIZE + UTF8_MAX_LEN];
+	bool is_stdin = path == NULL || strcmp(path, "-") == 0;
+	FILE * file = is_stdin ? stdin : fopen(path, "rb");
+	size_t carry = 0;
+
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	while (true) {
+		size_t read = fread(buf + carry, 1, EXPLAIN_BUF_SIZE, file);
+		size_t len = carry + read;
+		if (len == 0) break;
+
+		size_t used = explain_buffer(index, buf, len, read == 0, true, out);
+		if (read == 0) break;
+		carry = len - used;
+		memmove(buf, buf + used, carry);
+	}
+
+	bool success = !ferror(file);
+	if (!success)
+		fprintf(stderr, "Error reading %s: %s\n",
+			is_stdin ? "standard input" : path, strerror(errno));
+	if (!is_stdin) fclose(file);
+	return success;
+}
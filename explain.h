@@ -0,0 +1,20 @@
+#ifndef EXPLAIN_H
+#define EXPLAIN_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "ucd_index.h"
+
+// For each character in the UTF-8 text, prints its decomposition tree, with
+// the name of the code point at every node, followed by its full canonical
+// and compatibility decompositions. Invalid bytes are reported.
+void explain_text (const ucd_index * index, const char * text, size_t len, FILE * out);
+
+// Like explain_text for the contents of a file, leaving out line breaks.
+// path NULL or "-" reads standard input. Returns false if the file could
+// not be read.
+bool explain_file (const ucd_index * index, const char * path, FILE * out);
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ *  Finds characters whose names match a pattern in files.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <regex.h>
+
+#include "common.h"
+#include "find.h"
+#include "utf8.h"
+#include "codepoint_set.h"
+
+#define FIND_BUF_SIZE (1 << 20)
+
+#define STDIN_NAME "(standard input)"
+
+static bool name_matches_regex (const char * name, void * regex) {
+	return regexec(regex, name, 0, NULL, 0) == 0;
+}
+
+uint64_t * find_compile_pattern (const ucd_index * index, const char * pattern) {
+	regex_t regex;
+	int status = regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB | REG_ICASE);
+	if (status != 0) {
+		char message[BUFSIZ];
+		regerror(status, &regex, message, sizeof message);
+		fprintf(stderr, "Invalid pattern '%s': %s\n", pattern, message);
+		return NULL;
+	}
+
+	uint64_t * bitmap = NULL;
+	codepoint_set * set = ucd_index_match_names(index, name_matches_regex, &regex);
+	regfree(&regex);
+	if (set == NULL) return NULL;
+
+	bitmap = malloc(CODEPOINT_BITMAP_WORDS * sizeof *bitmap);
+	if (bitmap != NULL) codepoint_set_fill_bitmap(set, bitmap);
+	else perror(MEM_ERR);
+
+	codepoint_set_free(&set);
+	return bitmap;
+}
+
+static void print_match (const ucd_index * index, const char * path,
+						 size_t line, size_t column, unichar codepoint) {
+	char * name = ucd_index_get_name(index, codepoint);
+	printf("%s:%zu:%zu: U+%04X %s\n", path, line, column, codepoint,
+		name != NULL ? name : "error");
+	free(name);
+}
+
+long find_in_file (const ucd_index * index, const uint64_t * bitmap, const char * path) {
+	static unsigned char buf[FIND_BUF_SIZE + UTF8_MAX_LEN];
+	size_t carry = 0, line = 1, column = 1;
+	long matches = 0;
+	bool is_stdin = path == NULL || strcmp(path, "-") == 0;
+	FILE * file = is_stdin ? stdin : fopen(path, "rb");
+
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (is_stdin) path = STDIN_NAME;
+
+	while (true) {
+		size_t read = fread(buf + carry, 1, FIND_BUF_SIZE, file);
+		size_t len = carry + read, i = 0;
+		bool at_eof = read == 0;
+
+		if (len == 0) break;
+
+		while (i < len) {
+			// Skip ASCII, which is never reported, counting lines.
+			size_t ascii = utf8_ascii_prefix(buf + i, len - i);
+			if (ascii > 0) {
+				const unsigned char * newline = buf + i, * end = buf + i + ascii,
+					* last_newline = NULL;
+				while ((newline = memchr(newline, '\n', end - newline)) != NULL)
+					++line, last_newline = newline++;
+				column = last_newline != NULL ? end - last_newline : column + ascii;
+				i += ascii;
+				continue;
+			}
+
+			unichar codepoint;
+			size_t seq_len = utf8_decode(buf + i, len - i, &codepoint);
+			if (seq_len == 0) { // sequence continues in the next read
+				if (!at_eof) break;
+				codepoint = UTF8_INVALID, seq_len = 1;
+			}
+			if (codepoint != UTF8_INVALID && CODEPOINT_BITMAP_TEST(bitmap, codepoint)) {
+				print_match(index, path, line, column, codepoint);
+				++matches;
+			}
+			++column;
+			i += seq_len;
+		}
+
+		carry = len - i;
+		memmove(buf, buf + i, carry);
+		if (at_eof) break;
+	}
+
+	if (ferror(file)) {
+		fprintf(stderr, "Error reading %s: %s\n", path, strerror(errno));
+		matches = -1;
+	}
+	if (!is_stdin) fclose(file);
+
+	return matches;
+}
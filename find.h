@@ -0,0 +1,20 @@
+#ifndef FIND_H
+#define FIND_H
+
+#include <stdint.h>
+
+#include "ucd_index.h"
+
+// Matches pattern, a case-insensitive POSIX extended regular expression,
+// against every name and alias once, and returns a flat bitmap of the code
+// points that match (see CODEPOINT_BITMAP_WORDS), or NULL. Must be freed.
+uint64_t * find_compile_pattern (const ucd_index * index, const char * pattern);
+
+// Prints "file:line:column: U+XXXX NAME" for every non-ASCII character in
+// the file that is in bitmap. Lines and columns count from 1; columns count
+// code points. Bytes that are not valid UTF-8 count as one column each.
+// path NULL or "-" reads standard input.
+// Returns the number of matches, or -1 if the file could not be read.
+long find_in_file (const ucd_index * index, const uint64_t * bitmap, const char * path);
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ *  Counts how often each non-ASCII code point occurs in files.
+ */
+
+#define _FILE_OFFSET_BITS 64 // for fseeko on files over 2 GiB
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "histogram.h"
+#include "utf8.h"
+
+#define FREE_AND_NULL(mem) (free(mem), (mem) = NULL)
+
+#define PLANE_COUNT 17
+#define PLANE_SIZE  0x10000
+
+#define CHUNK_SIZE (4 << 20)
+// Bytes past the end of a chunk that may complete its last sequence.
+#define CHUNK_OVERLAP (UTF8_MAX_LEN - 1)
+
+#define IS_CONTINUATION(byte) (((byte) & 0xC0) == 0x80)
+
+typedef struct histogram_job {
+	const char * path; // NULL for standard input
+	off_t offset;
+	off_t length; // -1: read to the end as a stream
+} histogram_job;
+
+typedef struct histogram_jobs {
+	histogram_job * jobs;
+	size_t count;
+	atomic_size_t next;
+} histogram_jobs;
+
+// Counters for each plane are allocated when a code point in it is first seen.
+typedef struct histogram_counts {
+	uint64_t * planes[PLANE_COUNT];
+} histogram_counts;
+
+typedef struct histogram_worker {
+	pthread_t thread;
+	histogram_jobs * jobs;
+	histogram_counts counts;
+	unsigned char * buf;
+	bool failed;
+} histogram_worker;
+
+static void counts_free (histogram_counts * counts) {
+	for (int i = 0; i < PLANE_COUNT; ++i) FREE_AND_NULL(counts->planes[i]);
+}
+
+// Counts the sequences that begin in buf[start, end). Sequences may extend
+// to len. Returns the offset of the first sequence that was not counted
+// because it is incomplete, or end.
+static size_t count_buffer (histogram_counts * counts, const unsigned char * buf,
+							size_t start, size_t end, size_t len, bool * failed) {
+	size_t i = start;
+
+	while (i < end) {
+		size_t ascii = utf8_ascii_prefix(buf + i, end - i);
+		if ((i += ascii) == end) break;
+
+		unichar codepoint;
+		size_t seq_len = utf8_decode(buf + i, len - i, &codepoint);
+		if (seq_len == 0) return i;
+
+		if (codepoint != UTF8_INVALID) {
+			uint64_t * * plane = &counts->planes[codepoint >> 16];
+			if (*plane == NULL && (*plane = calloc(PLANE_SIZE, sizeof **plane)) == NULL) {
+				perror(MEM_ERR); *failed = true; return end;
+			}
+			++(*plane)[codepoint & 0xFFFF];
+		}
+		i += seq_len;
+	}
+
+	return end;
+}
+
+static bool run_chunk_job (histogram_worker * worker, const histogram_job * job) {
+	FILE * file = fopen(job->path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", job->path, strerror(errno));
+		return false;
+	}
+
+	bool success = fseeko(file, job->offset, SEEK_SET) == 0;
+	size_t len = success ? fread(worker->buf, 1, job->length + CHUNK_OVERLAP, file) : 0;
+	if (!success || ferror(file)) {
+		fprintf(stderr, "Error reading %s: %s\n", job->path, strerror(errno));
+		success = false;
+	}
+	fclose(file);
+	if (!success) return false;
+
+	// Continuation bytes at the start belong to the previous chunk's last
+	// sequence.
+	size_t start = 0, end = len < job->length ? len : job->length;
+	if (job->offset > 0)
+		while (start < CHUNK_OVERLAP && start < len && IS_CONTINUATION(worker->buf[start]))
+			++start;
+
+	size_t stop = count_buffer(&worker->counts, worker->buf, start, end, len, &worker->failed);
+	// A sequence cut off by the end of the file is invalid; skip it.
+	if (stop < end)
+		count_buffer(&worker->counts, worker->buf, stop + 1, end, len, &worker->failed);
+
+	return !worker->failed;
+}
+
+static bool run_stream_job (histogram_worker * worker, const histogram_job * job) {
+	bool is_stdin = job->path == NULL;
+	FILE * file = is_stdin ? stdin : fopen(job->path, "rb");
+	size_t carry = 0;
+
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s: %s\n", job->path, strerror(errno));
+		return false;
+	}
+
+	while (!worker->failed) {
+		size_t read = fread(worker->buf + carry, 1, CHUNK_SIZE, file);
+		size_t len = carry + read;
+		if (len == 0) break;
+
+		size_t stop = count_buffer(&worker->counts, worker->buf, 0, len, len, &worker->failed);
+		if (read == 0) { // at the end: the carried bytes are invalid
+			if (stop < len)
+				count_buffer(&worker->counts, worker->buf, stop + 1, len, len, &worker->failed);
+			break;
+		}
+		carry = len - stop;
+		memmove(worker->buf, worker->buf + stop, carry);
+	}
+
+	bool success = !ferror(file) && !worker->failed;
+	if (ferror(file))
+		fprintf(stderr, "Error reading %s: %s\n",
+			is_stdin ? "standard input" : job->path, strerror(errno));
+	if (!is_stdin) fclose(file);
+	return success;
+}
+
+// Takes jobs until there are none left. Taking a job is a single atomic
+// increment; counting touches only the worker's own arrays.
+static void * histogram_worker_run (void * data) {
+	histogram_worker * worker = data;
+	size_t job_index;
+
+	while ((job_index = atomic_fetch_add(&worker->jobs->next, 1)) < worker->jobs->count) {
+		const histogram_job * job = &worker->jobs->jobs[job_index];
+		if (!(job->length < 0 ? run_stream_job(worker, job) : run_chunk_job(worker, job)))
+			worker->failed = true;
+	}
+
+	return NULL;
+}
+
+static bool add_job (histogram_jobs * jobs, size_t * size, histogram_job job) {
+	if (jobs->count == *size) {
+		*size = *size == 0 ? 64 : *size * 2;
+		histogram_job * new_jobs = realloc(jobs->jobs, *size * sizeof *new_jobs);
+		MEM_ERR_RETURN_FALSE(new_jobs);
+		jobs->jobs = new_jobs;
+	}
+	jobs->jobs[jobs->count++] = job;
+	return true;
+}
+
+// Regular files are split into chunks; anything else is read as a stream.
+static bool make_jobs (histogram_jobs * jobs, char * const * paths, int path_count) {
+	size_t size = 0;
+	struct stat st;
+
+	if (path_count == 0)
+		return add_job(jobs, &size, (histogram_job) { NULL, 0, -1 });
+
+	for (int i = 0; i < path_count; ++i) {
+		const char * path = strcmp(paths[i], "-") == 0 ? NULL : paths[i];
+		if (path != NULL && stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+			for (off_t offset = 0; offset < st.st_size; offset += CHUNK_SIZE) {
+				off_t length = st.st_size - offset < CHUNK_SIZE ? st.st_size - offset : CHUNK_SIZE;
+				if (!add_job(jobs, &size, (histogram_job) { path, offset, length }))
+					return false;
+			}
+		}
+		else if (!add_job(jobs, &size, (histogram_job) { path, 0, -1 }))
+			return false;
+	}
+
+	return true;
+}
+
+// Adds the counts of source to dest and frees them.
+static void counts_merge (histogram_counts * dest, histogram_counts * source) {
+	for (int i = 0; i < PLANE_COUNT; ++i) {
+		if (source->planes[i] == NULL) continue;
+		if (dest->planes[i] == NULL) {
+			dest->planes[i] = source->planes[i];
+			source->planes[i] = NULL;
+		}
+		else {
+			for (size_t j = 0; j < PLANE_SIZE; ++j)
+				dest->planes[i][j] += source->planes[i][j];
+			FREE_AND_NULL(source->planes[i]);
+		}
+	}
+}
+
+static histogram_entry * counts_to_entries (const histogram_counts * counts,
+											size_t * entry_count) {
+	size_t count = 0, n = 0;
+	for (int i = 0; i < PLANE_COUNT; ++i)
+		if (counts->planes[i] != NULL)
+			for (size_t j = 0; j < PLANE_SIZE; ++j)
+				count += counts->planes[i][j] != 0;
+
+	histogram_entry * entries = malloc((count > 0 ? count : 1) * sizeof *entries);
+	MEM_ERR_RETURN_NULL(entries);
+
+	for (int i = 0; i < PLANE_COUNT; ++i)
+		if (counts->planes[i] != NULL)
+			for (size_t j = 0; j < PLANE_SIZE; ++j)
+				if (counts->planes[i][j] != 0)
+					entries[n++] = (histogram_entry) { i << 16 | j, counts->planes[i][j] };
+
+	*entry_count = count;
+	return entries;
+}
+
+histogram_entry * histogram_count (char * const * paths, int path_count,
+								   int thread_count, size_t * entry_count) {
+	histogram_jobs jobs = { NULL, 0 };
+	histogram_worker * workers = NULL;
+	histogram_entry * entries = NULL;
+	int started = 0;
+	bool failed = false;
+
+	atomic_init(&jobs.next, 0);
+	if (!make_jobs(&jobs, paths, path_count)) goto cleanup;
+
+	if (thread_count < 1) thread_count = 1;
+	if (thread_count > jobs.count) thread_count = jobs.count > 0 ? jobs.count : 1;
+
+	workers = calloc(thread_count, sizeof *workers);
+	if (workers == NULL) { perror(MEM_ERR); goto cleanup; }
+
+	for (; started < thread_count; ++started) {
+		histogram_worker * worker = &workers[started];
+		worker->jobs = &jobs;
+		worker->buf = malloc(CHUNK_SIZE + CHUNK_OVERLAP);
+		if (worker->buf == NULL) {
+			perror(MEM_ERR); failed = true; break;
+		}
+		if ((errno = pthread_create(&worker->thread, NULL, histogram_worker_run, worker)) != 0) {
+			perror("Failed to start thread");
+			free(worker->buf); failed = true; break;
+		}
+	}
+	// If not all threads started, the ones that did still take every job.
+	failed = failed && started == 0;
+
+	for (int i = 0; i < started; ++i) {
+		pthread_join(workers[i].thread, NULL);
+		failed = failed || workers[i].failed;
+		FREE_AND_NULL(workers[i].buf);
+		if (i > 0) counts_merge(&workers[0].counts, &workers[i].counts);
+	}
+
+	if (!failed)
+		entries = counts_to_entries(&workers[0].counts, entry_count);
+
+cleanup:
+	if (workers != NULL) {
+		for (int i = 0; i < thread_count; ++i) counts_free(&workers[i].counts);
+		free(workers);
+	}
+	free(jobs.jobs);
+	return entries;
+}
+
+static int compare_by_count (const void * p1, const void * p2) {
+	const histogram_entry * a = p1, * b = p2;
+	if (a->count != b->count) return a->count < b->count ? 1 : -1;
+	return (a->codepoint > b->codepoint) - (a->codepoint < b->codepoint);
+}
+
+void histogram_sort_by_count (histogram_entry * entries, size_t entry_count) {
+	qsort(entries, entry_count, sizeof *entries, compare_by_count);
+}
@@ -0,0 +1,26 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "unicodename.h"
+
+typedef struct histogram_entry {
+	unichar codepoint;
+	uint64_t count;
+} histogram_entry;
+
+// Counts the non-ASCII code points in the files, or standard input if
+// path_count is 0, decoding UTF-8 on up to thread_count threads. Regular
+// files are split into chunks that the threads take in turn; each thread
+// counts into its own per-plane arrays, and the arrays are merged at the end.
+// Returns the code points that occur, in code point order, or NULL on error.
+// Must be freed.
+histogram_entry * histogram_count (char * const * paths, int path_count,
+								   int thread_count, size_t * entry_count);
+
+// Sorts by descending count, then by code point.
+void histogram_sort_by_count (histogram_entry * entries, size_t entry_count);
+
+#endif
@@ -9,7 +9,11 @@
 #include <stdint.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <inttypes.h>
 #include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #ifdef _WIN32
 #define MINGW_HAS_SECURE_API 1 // so that _printf_p is defined
@@ -18,6 +22,18 @@
 
 #include "common.h"
 #include "unicodename.h"
+#include "ucd_file.h"
+#include "ucd_index.h"
+#include "query.h"
+#include "find.h"
+#include "escape.h"
+#include "name_hash.h"
+#include "range_table.h"
+#include "histogram.h"
+#include "ucd_snapshot.h"
+#include "explain.h"
+#include "subset.h"
+#include "name_rank.h"
 
 // Define UNICODE_DATA_IN_CURRENT_DIR if you've put UnicodeData.txt and
 // NameAliases.txt in the current directory.
@@ -38,15 +54,17 @@
 
 #define UNICODE_DATA_PATH  "UnicodeData.txt"
 #define NAME_ALIASES_PATH  "NameAliases.txt"
+#define BLOCKS_PATH        "Blocks.txt"
+#define SCRIPTS_PATH       "Scripts.txt"
 
 // Or use DerivedName.txt? Doesn't indicate control codes, surrogates, etc.
 
 #define PROMPT "> "
 
-#define NAME_OUTPUT_FORMAT            "U+%2$X (decimal %2$d): %1$s\n"
-// #define NAME_OUTPUT_FORMAT            "%1$s\n"
+#define NAME_OUTPUT_FORMAT            "U+%2$X (decimal %2$d): %1$s"
+// #define NAME_OUTPUT_FORMAT            "%1$s"
 
-#define CODEPOINT_STR_LEN    7 // "XXXXXX"
+#define RELOAD_COMMAND       "reload"
 
 #define FREE0(pointer) ((pointer) != NULL ? free(pointer), (pointer) = NULL : NULL)
 #define FOPEN_ERR(filepath) \
@@ -54,11 +72,22 @@
 	 fflush(stderr))
 
 static int decimal = 0;
+static int print_names = 0;
+static const char * query = NULL;
+static const char * find_pattern = NULL;
+static enum { FILTER_NONE, FILTER_EXPAND, FILTER_ESCAPE } filter = FILTER_NONE;
+static enum escape_which escape_which = ESCAPE_NON_ASCII;
+static int print_block = 0, print_script = 0;
+static int histogram = 0;
+static int explain = 0;
+static enum { SORT_CODEPOINT, SORT_INPUT, SORT_NAME } sort_order = SORT_CODEPOINT;
+static long thread_count = 0; // 0: one per processor
 
 static char * UCD_directory;
 const char * default_UCD_directory = UCD_DIRECTORY;
 
 static FILE * Unicode_Data_txt = NULL, * Name_Aliases_txt = NULL;
+static range_table * blocks = NULL, * scripts = NULL;
 
 static bool open_UCD_file(const char * filename, FILE * * out) {
 	char * filepath = NULL;
@@ -69,7 +98,7 @@ static bool open_UCD_file(const char * filename, FILE * * out) {
 	filepath = ASPRINTF("%s%s", UCD_directory, filename);
 	
 	if (filepath != NULL) {
-		datafile = fopen(filepath, "r");
+		datafile = ucd_fopen(filepath);
 		
 		if (datafile != NULL) *out = datafile;
 		else FOPEN_ERR(filepath);
@@ -81,41 +110,55 @@ static bool open_UCD_file(const char * filename, FILE * * out) {
 	return datafile != NULL;
 }
 
+// Runs a command entered in interactive mode after ":".
+static void run_command (const char * command) {
+	size_t len = strlen(RELOAD_COMMAND);
+	if (strncmp(command, RELOAD_COMMAND, len) == 0
+			&& (command[len] == '\0' || isspace(command[len]))) {
+		const char * directory = command + len;
+		while (isspace(*directory)) ++directory;
+		if (ucd_snapshot_reload_async(*directory != '\0' ? directory : NULL))
+			puts("Reloading in the background.");
+	}
+	else
+		printf("Unknown command :%s\n", command);
+}
+
 static unichar read_codepoint () {
-	unichar codepoint;
 	size_t i;
-	static char codepoint_str[CODEPOINT_STR_LEN];
+	static char input[BUFSIZ + 1];
 	
 read_input:
 	while (1) {
 		printf("Hexadecimal codepoint to look up the name of?\n" PROMPT);
 		
-		// Newline on its own triggers exit.
-		if (read_line(stdin, codepoint_str, CODEPOINT_STR_LEN - 1) == 0)
+		// Newline on its own or end of input triggers exit.
+		size_t len = read_line(stdin, input, BUFSIZ);
+		if (len == 0 || len == (size_t) EOF)
 			return -1;
 		
+		if (input[0] == ':') {
+			run_command(input + 1); continue;
+		}
+		
 		i = 0;
-		while (isxdigit(codepoint_str[i])) ++i;
+		while (isxdigit(input[i])) ++i;
 		
-		if (codepoint_str[i] != '\0') { // Not all characters are hexadecimal.
+		if (input[i] != '\0') { // Not all characters are hexadecimal.
 			puts("Please enter a hexadecimal number."); continue;
 		}
 		else break;
 	}
 	
-	if (sscanf(codepoint_str, "%x", &codepoint) != 1) { // Should not happen.
-		char msg[BUFSIZ];
-		sprintf(msg, "Error converting %s to integer", codepoint_str);
-		perror(msg);
-		return -1;
-	}
-	
-	if (!CODEPOINT_VALID(codepoint)) {
+	// Leading zeros are allowed, so the value is checked, not the length.
+	errno = 0;
+	unsigned long value = strtoul(input, NULL, 16);
+	if (errno == ERANGE || !CODEPOINT_VALID(value)) {
 		puts("Maximum codepoint is U+10FFFF.");
 		goto read_input;
 	}
 	
-	return codepoint;
+	return value;
 }
 
 
@@ -152,7 +195,7 @@ static bool get_directory (const char * default_directory, const char * const fi
 	if (filepath == NULL) goto mem_err;
 	
 	while (true) {
-		file = fopen(filepath, "r");
+		file = ucd_fopen(filepath);
 		
 		if (file != NULL) {
 			*file_var = file;
@@ -215,38 +258,124 @@ static bool open_Unicode_data (bool crash_if_not_default) {
 	return true;
 }
 
+static range_table * load_range_table (const char * filename, const char * default_value) {
+	FILE * file = NULL;
+	range_table * table = NULL;
+	
+	if (open_UCD_file(filename, &file)) {
+		table = range_table_load(file, default_value);
+		fclose(file);
+	}
+	if (table == NULL)
+		fprintf(stderr, "Values from %s will not be printed.\n", filename);
+	
+	return table;
+}
+
+// Loads Blocks.txt and Scripts.txt if their columns were requested.
+static void load_range_tables (void) {
+	if (print_block) blocks = load_range_table(BLOCKS_PATH, "No_Block");
+	if (print_script) scripts = load_range_table(SCRIPTS_PATH, "Unknown");
+}
+
+// Prints the block and script columns of the tables that are loaded, each
+// preceded by a tab.
+static void print_range_columns (const range_table * block_table,
+								 const range_table * script_table, unichar codepoint) {
+	if (!CODEPOINT_VALID(codepoint)) return;
+	if (!ucd_in_subset(codepoint)) {
+		if (block_table != NULL) fputs("\t<out-of-subset>", stdout);
+		if (script_table != NULL) fputs("\t<out-of-subset>", stdout);
+		return;
+	}
+	if (block_table != NULL) printf("\t%s", range_table_lookup(block_table, codepoint));
+	if (script_table != NULL) printf("\t%s", range_table_lookup(script_table, codepoint));
+}
+
+#ifdef SIGHUP
+static void * reload_on_hangup (void * data) {
+	sigset_t * signals = data;
+	int signal;
+	
+	while (sigwait(signals, &signal) == 0)
+		ucd_snapshot_reload_async(NULL);
+	return NULL;
+}
+
+// SIGHUP is blocked in every thread and taken by a thread of its own, so
+// that reloading does not happen in a signal handler.
+static void start_reload_on_hangup (void) {
+	static sigset_t signals;
+	pthread_t thread;
+	
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGHUP);
+	if (pthread_sigmask(SIG_BLOCK, &signals, NULL) == 0
+			&& pthread_create(&thread, NULL, reload_on_hangup, &signals) == 0)
+		pthread_detach(thread);
+}
+#else
+static void start_reload_on_hangup (void) {}
+#endif
+
+// Looks up code points in the current snapshot of the data, which can be
+// replaced with ":reload" or SIGHUP while the prompt is running.
 static void do_prompt (void) {
 	unichar codepoint;
-	char * * codepoint_names = NULL;
+	ucd_snapshot * snapshot = ucd_snapshot_load(UCD_directory,
+		(print_block ? UCD_SNAPSHOT_BLOCKS : 0) | (print_script ? UCD_SNAPSHOT_SCRIPTS : 0));
+	
+	if (snapshot == NULL || !ucd_snapshot_publish(snapshot)) return;
+	start_reload_on_hangup();
 	
 	setvbuf(stdout, NULL, _IOLBF, 0);
 	
-	puts("To exit, press enter.");
+	puts("To exit, press enter. To reload the data, enter :reload, optionally\n"
+		 "followed by a directory.");
 
 	while (codepoint = read_codepoint(), codepoint != -1) {
-		codepoint_names = get_codepoint_names(Unicode_Data_txt, Name_Aliases_txt,
-											  &codepoint, 1, codepoint_names);
+		// A reload while this lookup runs does not free the data it uses.
+		snapshot = ucd_snapshot_acquire();
+		char * name = ucd_index_get_name(snapshot->index, codepoint);
 		
-		if (codepoint_names != NULL)
-			my_printf(NAME_OUTPUT_FORMAT, codepoint_names[0], codepoint);
+		if (name != NULL) {
+			my_printf(NAME_OUTPUT_FORMAT, name, codepoint);
+			print_range_columns(snapshot->blocks, snapshot->scripts, codepoint);
+			putchar('\n');
+		}
 		else
 			printf("Codepoint U+%X does not have a name.\n", codepoint);
+		
+		free(name);
+		ucd_snapshot_release(&snapshot);
 	}
-	free_codepoint_names(codepoint_names, 1);
+	ucd_snapshot_shutdown();
 }
 
 static int read_options (int argc, char * const * argv) {
 	static const struct option options[] = {
 		{ "directory", required_argument, NULL, 'f' },
 		{ "decimal", optional_argument, &decimal, 1 },
-		{ "hexadecimal", optional_argument, &decimal, 0 }
+		{ "hexadecimal", optional_argument, &decimal, 0 },
+		{ "query", required_argument, NULL, 'q' },
+		{ "names", no_argument, &print_names, 1 },
+		{ "find", required_argument, NULL, 'F' },
+		{ "expand", no_argument, NULL, 'E' },
+		{ "escape", optional_argument, NULL, 'e' },
+		{ "block", no_argument, &print_block, 1 },
+		{ "script", no_argument, &print_script, 1 },
+		{ "histogram", no_argument, &histogram, 1 },
+		{ "threads", required_argument, NULL, 'j' },
+		{ "explain", no_argument, &explain, 1 },
+		{ "sort", required_argument, NULL, 'S' },
+		{ NULL, 0, NULL, 0 }
 	};
 	
 	int c;
 	int option_index = 0;
 	const char * directory = NULL;
 	opterr = 0;
-	while ((c = getopt_long(argc, argv, "f:dx", options, &option_index)) != -1) {
+	while ((c = getopt_long(argc, argv, "f:dxq:nF:Ee::bsHj:DS:", options, &option_index)) != -1) {
 		switch (c) {
 			case 'd': case 'x':
 				decimal = c == 'd';
@@ -255,6 +384,59 @@ static int read_options (int argc, char * const * argv) {
 				if (directory == NULL)
 					directory = optarg;
 				break;
+			case 'q':
+				query = optarg;
+				break;
+			case 'n':
+				print_names = 1;
+				break;
+			case 'F':
+				find_pattern = optarg;
+				break;
+			case 'E':
+				filter = FILTER_EXPAND;
+				break;
+			case 'b':
+				print_block = 1;
+				break;
+			case 's':
+				print_script = 1;
+				break;
+			case 'H':
+				histogram = 1;
+				break;
+			case 'D':
+				explain = 1;
+				break;
+			case 'S':
+				if (strcmp(optarg, "codepoint") == 0) sort_order = SORT_CODEPOINT;
+				else if (strcmp(optarg, "input") == 0) sort_order = SORT_INPUT;
+				else if (strcmp(optarg, "name") == 0) sort_order = SORT_NAME;
+				else {
+					fprintf(stderr, "--sort takes input, codepoint, or name, not %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'j': {
+				char * end;
+				thread_count = strtol(optarg, &end, 10);
+				if (*end != '\0' || thread_count < 1) {
+					fprintf(stderr, "--threads takes a positive number, not %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			}
+			case 'e':
+				filter = FILTER_ESCAPE;
+				if (optarg == NULL || strcmp(optarg, "nonascii") == 0)
+					escape_which = ESCAPE_NON_ASCII;
+				else if (strcmp(optarg, "nonprint") == 0)
+					escape_which = ESCAPE_NON_PRINTABLE;
+				else {
+					fprintf(stderr, "--escape takes nonascii or nonprint, not %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
 		}
 	}
 	
@@ -264,36 +446,298 @@ static int read_options (int argc, char * const * argv) {
 	return optind;
 }
 
+static void print_query_name (const ucd_index * index, unichar codepoint) {
+	char * name = ucd_index_get_name(index, codepoint);
+	printf("U+%04X %s", codepoint, name != NULL ? name : "error");
+	print_range_columns(blocks, scripts, codepoint);
+	putchar('\n');
+	free(name);
+}
+
+// Prints the code points of result one per line with names, sorted by name.
+static bool print_query_by_name (const ucd_index * index, const codepoint_set * result) {
+	unichar low, high;
+	size_t count = 0;
+	name_rank * ranks = name_rank_new(index);
+	unichar * codepoints = malloc((codepoint_set_count(result) + 1) * sizeof *codepoints);
+	
+	if (ranks == NULL || codepoints == NULL) {
+		if (codepoints == NULL) perror(MEM_ERR);
+		name_rank_free(&ranks); free(codepoints); return false;
+	}
+	
+	for (unichar codepoint = 0;
+			codepoint <= 0x10FFFF && codepoint_set_next_range(result, codepoint, &low, &high);
+			codepoint = high + 1)
+		for (unichar cp = low; cp <= high; ++cp) codepoints[count++] = cp;
+	
+	bool success = name_rank_sort(ranks, codepoints, count);
+	for (size_t i = 0; success && i < count; ++i)
+		print_query_name(index, codepoints[i]);
+	
+	name_rank_free(&ranks);
+	free(codepoints);
+	return success;
+}
+
+// Prints the code points that match query as ranges, or one per line with
+// names.
+static bool do_query (void) {
+	unichar low, high;
+	ucd_index * index = ucd_index_load(Unicode_Data_txt, Name_Aliases_txt);
+	if (index == NULL) return false;
+	
+	codepoint_set * result = query_evaluate(index, query);
+	if (result == NULL) {
+		ucd_index_free(&index); return false;
+	}
+	
+	if (print_names && sort_order == SORT_NAME) {
+		bool success = print_query_by_name(index, result);
+		codepoint_set_free(&result);
+		ucd_index_free(&index);
+		return success;
+	}
+	
+	for (unichar codepoint = 0;
+			codepoint <= 0x10FFFF && codepoint_set_next_range(result, codepoint, &low, &high);
+			codepoint = high + 1) {
+		if (print_names) {
+			for (unichar cp = low; cp <= high; ++cp)
+				print_query_name(index, cp);
+		}
+		else if (low == high) printf("%04X\n", low);
+		else printf("%04X..%04X\n", low, high);
+	}
+	
+	codepoint_set_free(&result);
+	ucd_index_free(&index);
+	return true;
+}
+
+// Searches the files, or standard input if there are none, for characters
+// whose names match find_pattern. Returns an exit status like grep's:
+// 0 if something was found, 1 if not, 2 on error.
+static int do_find (char * const * paths, int path_count) {
+	int status = 1;
+	ucd_index * index = ucd_index_load(Unicode_Data_txt, Name_Aliases_txt);
+	if (index == NULL) return 2;
+	
+	uint64_t * bitmap = find_compile_pattern(index, find_pattern);
+	if (bitmap == NULL) {
+		ucd_index_free(&index); return 2;
+	}
+	
+	for (int i = 0; i < (path_count > 0 ? path_count : 1); ++i) {
+		long matches = find_in_file(index, bitmap, path_count > 0 ? paths[i] : NULL);
+		if (matches < 0) status = 2;
+		else if (matches > 0 && status == 1) status = 0;
+	}
+	
+	free(bitmap);
+	ucd_index_free(&index);
+	return status;
+}
+
+// Expands or adds \N{...} escapes in the files, or standard input if there
+// are none, writing to standard output.
+static bool do_filter (char * const * paths, int path_count) {
+	bool success = true;
+	name_hash * names = NULL;
+	ucd_index * index = ucd_index_load(Unicode_Data_txt, Name_Aliases_txt);
+	if (index == NULL) return false;
+	
+	if (filter == FILTER_EXPAND && (names = name_hash_new(index)) == NULL) {
+		ucd_index_free(&index); return false;
+	}
+	
+	for (int i = 0; success && i < (path_count > 0 ? path_count : 1); ++i) {
+		const char * path = path_count > 0 ? paths[i] : "-";
+		FILE * in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+		if (in == NULL) {
+			FOPEN_ERR(path); success = false; break;
+		}
+		
+		success = filter == FILTER_EXPAND
+			? escape_expand(in, stdout, names)
+			: escape_names(in, stdout, index, escape_which);
+		if (!success) perror("Failed to filter text");
+		
+		if (in != stdin) fclose(in);
+	}
+	
+	name_hash_free(&names);
+	ucd_index_free(&index);
+	return success;
+}
+
+// Prints the decomposition of each character in the strings, or in standard
+// input if there are none.
+static bool do_explain (char * const * strings, int string_count) {
+	bool success = true;
+	ucd_index * index = ucd_index_load(Unicode_Data_txt, Name_Aliases_txt);
+	if (index == NULL) return false;
+	
+	if (string_count == 0)
+		success = explain_file(index, NULL, stdout);
+	for (int i = 0; i < string_count; ++i)
+		explain_text(index, strings[i], strlen(strings[i]), stdout);
+	
+	ucd_index_free(&index);
+	return success;
+}
+
+static int compare_codepoints (const void * p1, const void * p2) {
+	unichar a = *(const unichar *) p1, b = *(const unichar *) p2;
+	return (a > b) - (a < b);
+}
+
+// Prints how often each non-ASCII code point occurs in the files, or
+// standard input if there are none, most frequent first.
+static bool do_histogram (char * const * paths, int path_count) {
+	size_t entry_count = 0;
+	long threads = thread_count;
+	if (threads == 0 && (threads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		threads = 1;
+	
+	histogram_entry * entries = histogram_count(paths, path_count, threads, &entry_count);
+	if (entries == NULL) return false;
+	if (entry_count == 0) {
+		free(entries); return true;
+	}
+	
+	// Only the code points that occur are looked up. The entries are in
+	// code point order, as get_codepoint_names wants.
+	unichar * codepoints = malloc(entry_count * sizeof *codepoints);
+	if (codepoints == NULL) {
+		perror(MEM_ERR); free(entries); return false;
+	}
+	for (size_t i = 0; i < entry_count; ++i) codepoints[i] = entries[i].codepoint;
+	
+	char * * names = get_codepoint_names(Unicode_Data_txt, Name_Aliases_txt,
+										 codepoints, entry_count, NULL);
+	if (names == NULL) {
+		free(codepoints); free(entries); return false;
+	}
+	
+	histogram_sort_by_count(entries, entry_count);
+	for (size_t i = 0; i < entry_count; ++i) {
+		const unichar * found = bsearch(&entries[i].codepoint, codepoints, entry_count,
+										sizeof *codepoints, compare_codepoints);
+		const char * name = found != NULL ? names[found - codepoints] : NULL;
+		printf("%" PRIu64 "\tU+%04X %s", entries[i].count, entries[i].codepoint,
+			name != NULL ? name : "error");
+		print_range_columns(blocks, scripts, entries[i].codepoint);
+		putchar('\n');
+	}
+	
+	free_codepoint_names(names, entry_count);
+	free(codepoints);
+	free(entries);
+	return true;
+}
+
+static bool sort_by_name (unichar * codepoints, size_t count) {
+	bool success = false;
+	name_rank * ranks = NULL;
+	ucd_index * index = ucd_index_load(Unicode_Data_txt, Name_Aliases_txt);
+	
+	if (index != NULL && (ranks = name_rank_new(index)) != NULL)
+		success = name_rank_sort(ranks, codepoints, count);
+	
+	name_rank_free(&ranks);
+	ucd_index_free(&index);
+	return success;
+}
+
+// Prints the names of the code points in args, in the order set by --sort.
+static bool do_lookup (char * const * args, size_t codepoint_count) {
+	unichar codepoint;
+	bool success = false;
+	char * * codepoint_names = NULL;
+	unichar * codepoints = malloc(codepoint_count * sizeof *codepoints),
+		* sorted = malloc(codepoint_count * sizeof *sorted);
+	
+	if (codepoints == NULL || sorted == NULL) {
+		perror(MEM_ERR); goto cleanup;
+	}
+	for (int i = 0; i < codepoint_count; ++i) {
+		codepoints[i] = (sscanf(args[i], decimal ? "%d" : "%x", &codepoint) == 1)
+						? codepoint : -1;
+	}
+	
+	// get_codepoint_names sorts its array in code point order, and returns
+	// the names in that order.
+	memcpy(sorted, codepoints, codepoint_count * sizeof *sorted);
+	codepoint_names = get_codepoint_names(
+			Unicode_Data_txt, Name_Aliases_txt, sorted, codepoint_count, NULL);
+	if (codepoint_names == NULL) goto cleanup;
+	
+	if (sort_order == SORT_CODEPOINT)
+		memcpy(codepoints, sorted, codepoint_count * sizeof *codepoints);
+	else if (sort_order == SORT_NAME && !sort_by_name(codepoints, codepoint_count))
+		goto cleanup;
+	
+	for (int i = 0; i < codepoint_count; ++i) {
+		const unichar * found = bsearch(&codepoints[i], sorted, codepoint_count,
+										sizeof *sorted, compare_codepoints);
+		const char * name = found != NULL ? codepoint_names[found - sorted] : NULL;
+		fputs(name != NULL ? name : "error", stdout);
+		print_range_columns(blocks, scripts, codepoints[i]);
+		putchar('\n');
+	}
+	success = true;
+	
+cleanup:
+	if (codepoint_names != NULL) free_codepoint_names(codepoint_names, codepoint_count);
+	free(codepoints);
+	free(sorted);
+	return success;
+}
+
 // TODO: allow Unicode data directory to be specified with command line arg.
 // TODO: allow code points to be input in decimal.
 int main (int argc, char * const * argv) {
+	int status = EXIT_SUCCESS;
 	if (argc > 1) {
-		unichar codepoint;
 		int first_codepoint_index = read_options(argc, argv);
 		// Open Unicode_Data_txt and optionally Name_Aliases_txt.
 		// Exit if directory is not correct.
 		open_Unicode_data(true);
 		size_t codepoint_count = argc - first_codepoint_index;
-		unichar * codepoints = malloc(codepoint_count * sizeof *codepoints);
-		if (!(codepoint_count > 0)) {
-			fputs("no codepoints provided", stderr);
-			return EXIT_FAILURE;
+		bool interactive = query == NULL && find_pattern == NULL && !explain && !histogram
+			&& filter == FILTER_NONE && codepoint_count == 0;
+		// Interactive mode reads the tables into its snapshot instead.
+		if (!interactive) load_range_tables();
+		if (query != NULL) {
+			status = do_query() ? EXIT_SUCCESS : EXIT_FAILURE;
+			goto close_files;
 		}
-		for (int i = 0; i < codepoint_count; ++i) {
-			codepoints[i] = (sscanf(argv[first_codepoint_index + i],
-									decimal ? "%d" : "%x", &codepoint) == 1)
-							? codepoint : -1;
+		else if (find_pattern != NULL) {
+			status = do_find(argv + first_codepoint_index, argc - first_codepoint_index);
+			goto close_files;
 		}
-		char * * codepoint_names = get_codepoint_names(
-				Unicode_Data_txt, Name_Aliases_txt, codepoints, codepoint_count, NULL);
-		free(codepoints);
-		if (codepoint_names == NULL)
+		else if (explain) {
+			status = do_explain(argv + first_codepoint_index, argc - first_codepoint_index)
+				? EXIT_SUCCESS : EXIT_FAILURE;
 			goto close_files;
-		
-		for (int i = 0; i < codepoint_count; ++i)
-			puts(codepoint_names[i] != NULL ? codepoint_names[i] : "error");
-		
-		free_codepoint_names(codepoint_names, codepoint_count);
+		}
+		else if (histogram) {
+			status = do_histogram(argv + first_codepoint_index, argc - first_codepoint_index)
+				? EXIT_SUCCESS : EXIT_FAILURE;
+			goto close_files;
+		}
+		else if (filter != FILTER_NONE) {
+			status = do_filter(argv + first_codepoint_index, argc - first_codepoint_index)
+				? EXIT_SUCCESS : EXIT_FAILURE;
+			goto close_files;
+		}
+		if (interactive) { // only options
+			do_prompt();
+			goto close_files;
+		}
+		status = do_lookup(argv + first_codepoint_index, codepoint_count)
+			? EXIT_SUCCESS : EXIT_FAILURE;
 	}
 	else {
 		if (!open_Unicode_data(false)) exit(EXIT_FAILURE); // Open Unicode_Data_txt and optionally Name_Aliases_txt.
@@ -301,10 +745,11 @@ int main (int argc, char * const * argv) {
 	}
 	
 close_files:
+	range_table_free(&blocks), range_table_free(&scripts);
 	if (UCD_directory != default_UCD_directory)
 		free(UCD_directory);
 	if (fclose(Unicode_Data_txt) || (Name_Aliases_txt != NULL && fclose(Name_Aliases_txt)))
 		perror("Failed to close file");
 	
-	return EXIT_SUCCESS;
+	return status;
 }
\ No newline at end of file
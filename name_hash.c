@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "common.h"
+#include "name_hash.h"
+
+#define FREE_AND_NULL(mem) (free(mem), (mem) = NULL)
+
+#define EMPTY_SLOT UINT32_MAX
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME        16777619u
+
+typedef struct name_hash_entry {
+	uint32_t name; // offset in strings, or EMPTY_SLOT
+	unichar codepoint;
+} name_hash_entry;
+
+struct name_hash {
+	const ucd_index * index;
+	name_hash_entry * entries;
+	uint32_t size, count; // size is a power of 2
+	char * strings;
+	size_t strings_len, strings_size;
+};
+
+static uint32_t hash_name (const char * name) {
+	uint32_t hash = FNV_OFFSET_BASIS;
+	for (; *name != '\0'; ++name) hash = (hash ^ (unsigned char) *name) * FNV_PRIME;
+	return hash;
+}
+
+static bool name_hash_grow (name_hash * hash) {
+	uint32_t old_size = hash->size;
+	name_hash_entry * old_entries = hash->entries;
+	uint32_t size = old_size == 0 ? 1 << 16 : old_size * 2;
+
+	name_hash_entry * entries = malloc(size * sizeof *entries);
+	MEM_ERR_RETURN_FALSE(entries);
+	for (uint32_t i = 0; i < size; ++i) entries[i].name = EMPTY_SLOT;
+
+	for (uint32_t i = 0; i < old_size; ++i) {
+		if (old_entries[i].name == EMPTY_SLOT) continue;
+		uint32_t slot = hash_name(hash->strings + old_entries[i].name) & (size - 1);
+		while (entries[slot].name != EMPTY_SLOT) slot = (slot + 1) & (size - 1);
+		entries[slot] = old_entries[i];
+	}
+
+	free(old_entries);
+	hash->entries = entries;
+	hash->size = size;
+	return true;
+}
+
+// The first name added for a code point wins, so names come before aliases.
+static bool name_hash_add (name_hash * hash, const char * name, size_t len,
+						   unichar codepoint) {
+	if ((hash->count + 1) * 2 > hash->size && !name_hash_grow(hash))
+		return false;
+
+	if (hash->strings_len + len + 1 > hash->strings_size) {
+		size_t size = hash->strings_size == 0 ? 1 << 20 : hash->strings_size * 2;
+		while (size < hash->strings_len + len + 1) size *= 2;
+		char * strings = realloc(hash->strings, size);
+		MEM_ERR_RETURN_FALSE(strings);
+		hash->strings = strings;
+		hash->strings_size = size;
+	}
+	char * stored = hash->strings + hash->strings_len;
+	memcpy(stored, name, len);
+	stored[len] = '\0';
+
+	uint32_t slot = hash_name(stored) & (hash->size - 1);
+	while (hash->entries[slot].name != EMPTY_SLOT) {
+		if (strcmp(hash->strings + hash->entries[slot].name, stored) == 0)
+			return true;
+		slot = (slot + 1) & (hash->size - 1);
+	}
+
+	hash->entries[slot].name = hash->strings_len;
+	hash->entries[slot].codepoint = codepoint;
+	hash->strings_len += len + 1;
+	++hash->count;
+	return true;
+}
+
+// If name is PREFIX-XXXX, the code point that the suffix names.
+static bool parse_hex_suffix (const char * name, unichar * codepoint) {
+	const char * hyphen = strrchr(name, '-');
+	char * end;
+	if (hyphen == NULL || !isxdigit((unsigned char) hyphen[1])) return false;
+	unsigned long value = strtoul(hyphen + 1, &end, 16);
+	if (*end != '\0' || end - (hyphen + 1) < 4 || !CODEPOINT_VALID(value))
+		return false;
+	*codepoint = value;
+	return true;
+}
+
+static bool add_names_and_aliases (name_hash * hash, unichar codepoint) {
+	char buf[UCD_NAME_BUF_LEN];
+	const char * name = ucd_index_name(hash->index, codepoint, buf);
+	if (name != NULL && name[0] != '<'
+			&& !name_hash_add(hash, name, strlen(name), codepoint))
+		return false;
+
+	const char * aliases = ucd_index_aliases(hash->index, codepoint);
+	while (aliases != NULL) {
+		const char * end = strstr(aliases, ", ");
+		size_t len = end != NULL ? (size_t) (end - aliases) : strlen(aliases);
+		if (!name_hash_add(hash, aliases, len, codepoint)) return false;
+		aliases = end != NULL ? end + 2 : NULL;
+	}
+	return true;
+}
+
+name_hash * name_hash_new (const ucd_index * index) {
+	char buf[UCD_NAME_BUF_LEN];
+	name_hash * hash = calloc(1, sizeof *hash);
+	MEM_ERR_RETURN_NULL(hash);
+	hash->index = index;
+
+	for (size_t i = 0; i < index->record_count; ++i) {
+		const ucd_record * record = &index->records[i];
+		unichar suffix_codepoint;
+
+		// Ranges whose names are labels or PREFIX-XXXX are skipped;
+		// the others (Hangul syllables) are listed name by name.
+		if (record->low != record->high) {
+			const char * name = ucd_index_name(index, record->low, buf);
+			if (name == NULL || name[0] == '<'
+					|| (parse_hex_suffix(name, &suffix_codepoint)
+					&& suffix_codepoint == record->low))
+				continue;
+		}
+
+		for (unichar codepoint = record->low; codepoint <= record->high; ++codepoint) {
+			if (!add_names_and_aliases(hash, codepoint)) {
+				name_hash_free(&hash); return NULL;
+			}
+		}
+	}
+
+	return hash;
+}
+
+void name_hash_free (name_hash * * hash) {
+	if (*hash != NULL) {
+		FREE_AND_NULL((*hash)->entries);
+		FREE_AND_NULL((*hash)->strings);
+		FREE_AND_NULL(*hash);
+	}
+}
+
+bool name_hash_find (const name_hash * hash, const char * name, unichar * codepoint) {
+	char key[UCD_NAME_BUF_LEN], buf[UCD_NAME_BUF_LEN];
+	size_t len = strlen(name);
+	if (len == 0 || len >= sizeof key) return false;
+	for (size_t i = 0; i <= len; ++i) key[i] = toupper((unsigned char) name[i]);
+
+	if (key[0] == 'U' && key[1] == '+' && isxdigit((unsigned char) key[2])) {
+		char * end;
+		unsigned long value = strtoul(key + 2, &end, 16);
+		if (*end != '\0' || !CODEPOINT_VALID(value)) return false;
+		*codepoint = value;
+		return true;
+	}
+
+	if (hash->size > 0) {
+		uint32_t slot = hash_name(key) & (hash->size - 1);
+		while (hash->entries[slot].name != EMPTY_SLOT) {
+			if (strcmp(hash->strings + hash->entries[slot].name, key) == 0) {
+				*codepoint = hash->entries[slot].codepoint;
+				return true;
+			}
+			slot = (slot + 1) & (hash->size - 1);
+		}
+	}
+
+	// CJK UNIFIED IDEOGRAPH-4E00 and the like
+	unichar suffix_codepoint;
+	const char * generated;
+	if (parse_hex_suffix(key, &suffix_codepoint)
+			&& (generated = ucd_index_name(hash->index, suffix_codepoint, buf)) != NULL
+			&& strcmp(generated, key) == 0) {
+		*codepoint = suffix_codepoint;
+		return true;
+	}
+
+	return false;
+}
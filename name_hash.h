@@ -0,0 +1,22 @@
+#ifndef NAME_HASH_H
+#define NAME_HASH_H
+
+#include <stdbool.h>
+
+#include "ucd_index.h"
+
+// Hash table from character names and aliases to code points.
+typedef struct name_hash name_hash;
+
+// Builds the table from the names and aliases in index, which must outlive
+// it. Names of the form PREFIX-XXXX generated from name_patterns are not
+// stored; they are recognized by their hexadecimal suffix.
+name_hash * name_hash_new (const ucd_index * index);
+
+void name_hash_free (name_hash * * hash);
+
+// Finds the code point with the name or alias, ignoring case.
+// Also accepts "U+XXXX". Returns false if there is none.
+bool name_hash_find (const name_hash * hash, const char * name, unichar * codepoint);
+
+#endif
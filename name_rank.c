@@ -0,0 +1,165 @@
+/*
+ *  Ranks code points by name, for sorting by name.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "name_rank.h"
+#include "subset.h"
+
+#define FREE_AND_NULL(mem) (free(mem), (mem) = NULL)
+
+#define CODEPOINT_COUNT 0x110000
+#define NONCHARACTER_COUNT (32 + 17 * 2)
+
+// Groups of code points that are not records.
+enum rank_group {
+	GROUP_NONCHARACTER = -1,
+	GROUP_RESERVED = -2,
+	GROUP_OUT_OF_SUBSET = -3
+};
+
+struct name_rank {
+	const ucd_index * index;
+	uint32_t * record_ranks; // rank of the first code point of each record
+	uint32_t noncharacter_rank, reserved_rank, out_of_subset_rank;
+};
+
+// A name, or the first name of a group, and the number of ranks it takes.
+typedef struct rank_item {
+	char * name;
+	uint32_t count;
+	long record; // index of the record, or enum rank_group
+} rank_item;
+
+static int compare_items (const void * p1, const void * p2) {
+	return strcmp(((const rank_item *) p1)->name, ((const rank_item *) p2)->name);
+}
+
+static bool add_item (rank_item * items, size_t * item_count, const char * name,
+					  uint32_t count, long record) {
+	char * copy = ASPRINTF("%s", name);
+	if (copy == NULL) return false;
+	items[(*item_count)++] = (rank_item) { copy, count, record };
+	return true;
+}
+
+static bool assign_ranks (name_rank * ranks, rank_item * items, size_t * item_count) {
+	const ucd_index * index = ranks->index;
+	char buf[UCD_NAME_BUF_LEN];
+
+	for (size_t i = 0; i < index->record_count; ++i) {
+		const ucd_record * record = &index->records[i];
+		const char * name = ucd_index_name(index, record->low, buf);
+		if (!add_item(items, item_count, name != NULL ? name : "",
+				record->high - record->low + 1, i))
+			return false;
+	}
+
+	if (!add_item(items, item_count, "<noncharacter-", NONCHARACTER_COUNT, GROUP_NONCHARACTER)
+			|| !add_item(items, item_count, "<reserved-", CODEPOINT_COUNT, GROUP_RESERVED)
+			|| !add_item(items, item_count, "<out-of-subset-", CODEPOINT_COUNT,
+				GROUP_OUT_OF_SUBSET))
+		return false;
+
+	qsort(items, *item_count, sizeof *items, compare_items);
+
+	uint32_t rank = 0;
+	for (size_t i = 0; i < *item_count; ++i) {
+		switch (items[i].record) {
+			case GROUP_NONCHARACTER: ranks->noncharacter_rank = rank; break;
+			case GROUP_RESERVED: ranks->reserved_rank = rank; break;
+			case GROUP_OUT_OF_SUBSET: ranks->out_of_subset_rank = rank; break;
+			default: ranks->record_ranks[items[i].record] = rank;
+		}
+		rank += items[i].count;
+	}
+	return true;
+}
+
+name_rank * name_rank_new (const ucd_index * index) {
+	name_rank * ranks = calloc(1, sizeof *ranks);
+	MEM_ERR_RETURN_NULL(ranks);
+	ranks->index = index;
+
+	size_t item_count = 0;
+	rank_item * items = malloc((index->record_count + 3) * sizeof *items);
+	ranks->record_ranks = malloc(
+		(index->record_count > 0 ? index->record_count : 1) * sizeof *ranks->record_ranks);
+	if (items == NULL || ranks->record_ranks == NULL) {
+		perror(MEM_ERR);
+		name_rank_free(&ranks);
+	}
+	else if (!assign_ranks(ranks, items, &item_count))
+		name_rank_free(&ranks);
+
+	if (items != NULL)
+		for (size_t i = 0; i < item_count; ++i) free(items[i].name);
+	free(items);
+	return ranks;
+}
+
+void name_rank_free (name_rank * * ranks) {
+	if (*ranks != NULL) {
+		FREE_AND_NULL((*ranks)->record_ranks);
+		FREE_AND_NULL(*ranks);
+	}
+}
+
+uint32_t name_rank_of (const name_rank * ranks, unichar codepoint) {
+	if (!CODEPOINT_VALID(codepoint)) return UINT32_MAX;
+	if (!ucd_in_subset(codepoint)) return ranks->out_of_subset_rank + codepoint;
+
+	const ucd_record * record = ucd_index_find(ranks->index, codepoint);
+	if (record != NULL)
+		return ranks->record_ranks[record - ranks->index->records] + (codepoint - record->low);
+
+	if (BETWEEN(codepoint, 0xFDD0, 0xFDEF))
+		return ranks->noncharacter_rank + (codepoint - 0xFDD0);
+	if ((codepoint & 0xFFFE) == 0xFFFE)
+		return ranks->noncharacter_rank + 32 + (codepoint >> 16) * 2 + (codepoint & 1);
+	return ranks->reserved_rank + codepoint;
+}
+
+typedef struct rank_pair {
+	uint32_t rank;
+	unichar codepoint;
+} rank_pair;
+
+// Least significant digit first, a byte at a time. Each pass is stable, so
+// equal ranks keep their order. Passes over a byte that is the same in
+// every rank are skipped.
+bool name_rank_sort (const name_rank * ranks, unichar * codepoints, size_t count) {
+	size_t size = (count > 0 ? count : 1) * sizeof (rank_pair);
+	rank_pair * pairs = malloc(size), * sorted = malloc(size);
+	if (pairs == NULL || sorted == NULL) {
+		perror(MEM_ERR); free(pairs); free(sorted); return false;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+		pairs[i] = (rank_pair) { name_rank_of(ranks, codepoints[i]), codepoints[i] };
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		size_t offsets[256] = { 0 };
+		for (size_t i = 0; i < count; ++i) ++offsets[pairs[i].rank >> shift & 0xFF];
+		if (count == 0 || offsets[pairs[0].rank >> shift & 0xFF] == count) continue;
+
+		for (size_t byte = 0, total = 0; byte < 256; ++byte) {
+			size_t byte_count = offsets[byte];
+			offsets[byte] = total;
+			total += byte_count;
+		}
+		for (size_t i = 0; i < count; ++i)
+			sorted[offsets[pairs[i].rank >> shift & 0xFF]++] = pairs[i];
+
+		rank_pair * swap = pairs;
+		pairs = sorted, sorted = swap;
+	}
+
+	for (size_t i = 0; i < count; ++i) codepoints[i] = pairs[i].codepoint;
+	free(pairs);
+	free(sorted);
+	return true;
+}
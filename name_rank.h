@@ -0,0 +1,31 @@
+#ifndef NAME_RANK_H
+#define NAME_RANK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ucd_index.h"
+
+// Ranks of code points in the order of their names, so that code points can
+// be sorted by name by comparing integers.
+typedef struct name_rank name_rank;
+
+// Sorts the names in index, which must outlive the table, with strcmp.
+// Names generated for a range of code points, such as
+// CJK UNIFIED IDEOGRAPH-4E00 or HANGUL SYLLABLE GA, are kept together, in
+// code point order, where the first of them sorts. So are the labels of
+// noncharacters and of unassigned code points.
+name_rank * name_rank_new (const ucd_index * index);
+
+void name_rank_free (name_rank * * ranks);
+
+// The rank of the name of codepoint, without aliases. Invalid code points
+// have rank UINT32_MAX.
+uint32_t name_rank_of (const name_rank * ranks, unichar codepoint);
+
+// Sorts codepoints by name with a radix sort on their ranks. Code points
+// with the same name keep their order.
+bool name_rank_sort (const name_rank * ranks, unichar * codepoints, size_t count);
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ *  Parses and evaluates boolean queries over code point properties, names,
+ *  and ranges.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // for strcasecmp
+#include <ctype.h>
+
+#include "common.h"
+#include "query.h"
+#include "subset.h"
+
+#define MAX_TOKEN_LEN 127
+
+typedef struct query_parser {
+	const ucd_index * index;
+	const char * query, * pos;
+	bool failed;
+} query_parser;
+
+static codepoint_set * parse_or (query_parser * parser);
+
+static codepoint_set * query_error (query_parser * parser, const char * message) {
+	if (!parser->failed) {
+		fprintf(stderr, "Query error at column %d: %s\n  %s\n  %*s^\n",
+			(int) (parser->pos - parser->query) + 1, message,
+			parser->query, (int) (parser->pos - parser->query), "");
+		parser->failed = true;
+	}
+	return NULL;
+}
+
+static void skip_space (query_parser * parser) {
+	while (isspace((unsigned char) *parser->pos)) ++parser->pos;
+}
+
+// Skips c and any following space if it is the next character.
+static bool accept (query_parser * parser, char c) {
+	skip_space(parser);
+	if (*parser->pos != c) return false;
+	++parser->pos;
+	skip_space(parser);
+	return true;
+}
+
+#define IS_OPERATOR(c) ((c) == '&' || (c) == '|' || (c) == '!' || (c) == '(' || (c) == ')')
+#define IS_WORD_CHAR(c) (isalnum((unsigned char) (c)) || (c) == '_' || (c) == '+')
+
+// Reads a word into buf, which has space for MAX_TOKEN_LEN chars.
+static bool read_word (query_parser * parser, char * buf) {
+	size_t len = 0;
+	while (IS_WORD_CHAR(*parser->pos)) {
+		if (len == MAX_TOKEN_LEN) return false;
+		buf[len++] = *parser->pos++;
+	}
+	buf[len] = '\0';
+	return len > 0;
+}
+
+// A quoted string, or everything up to the next operator, with trailing
+// space removed.
+static bool read_text (query_parser * parser, char * buf) {
+	size_t len = 0;
+	bool quoted = *parser->pos == '"';
+
+	if (quoted) ++parser->pos;
+	while (*parser->pos != '\0'
+			&& (quoted ? *parser->pos != '"' : !IS_OPERATOR(*parser->pos))) {
+		if (len == MAX_TOKEN_LEN) return false;
+		buf[len++] = *parser->pos++;
+	}
+	if (quoted) {
+		if (*parser->pos != '"') return false;
+		++parser->pos;
+	}
+	else while (len > 0 && isspace((unsigned char) buf[len - 1])) --len;
+	buf[len] = '\0';
+	return len > 0;
+}
+
+static bool parse_codepoint (const char * str, unichar * codepoint) {
+	char * end;
+	if (toupper((unsigned char) str[0]) == 'U' && str[1] == '+') str += 2;
+	if (!isxdigit((unsigned char) str[0])) return false;
+	unsigned long value = strtoul(str, &end, 16);
+	if (*end != '\0' || !CODEPOINT_VALID(value)) return false;
+	*codepoint = value;
+	return true;
+}
+
+static codepoint_set * property_term (query_parser * parser,
+									  const char * property_name, const char * value_name) {
+	enum ucd_property property = ucd_property_from_name(property_name);
+	if ((int) property == -1) return query_error(parser, "unknown property");
+
+	int value = ucd_property_value_from_name(property, value_name);
+	if (value != -1) {
+		const codepoint_set * set = ucd_index_property_set(parser->index, property, value);
+		return set != NULL ? codepoint_set_copy(set) : codepoint_set_new();
+	}
+
+	// Groups of general categories: L, M, N, P, S, Z, C, and LC.
+	if (property == UCD_PROPERTY_GENERAL_CATEGORY
+			&& (strlen(value_name) == 1 || strcasecmp(value_name, "LC") == 0)) {
+		codepoint_set * result = codepoint_set_new();
+		const char * name;
+		for (int i = 0; result != NULL
+				&& (name = ucd_property_value_name(property, i)) != NULL; ++i) {
+			bool in_group = strlen(value_name) == 1
+				? toupper((unsigned char) value_name[0]) == name[0]
+				: name[0] == 'L' && strchr("ult", name[1]) != NULL;
+			const codepoint_set * set = ucd_index_property_set(parser->index, property, i);
+			if (in_group && set != NULL) {
+				codepoint_set * merged = codepoint_set_or(result, set);
+				codepoint_set_free(&result);
+				result = merged;
+			}
+		}
+		return result;
+	}
+
+	return query_error(parser, "unknown property value");
+}
+
+static codepoint_set * parse_term (query_parser * parser) {
+	char word[MAX_TOKEN_LEN + 1], value[MAX_TOKEN_LEN + 1];
+	const char * term_start = parser->pos;
+
+	if (!read_word(parser, word))
+		return query_error(parser, "expected property, name, or code point");
+
+	if (*parser->pos == '=') {
+		++parser->pos;
+		if (!read_word(parser, value)) return query_error(parser, "expected value");
+		return property_term(parser, word, value);
+	}
+	else if (*parser->pos == ':') {
+		++parser->pos;
+		if (strcasecmp(word, "name") != 0) return query_error(parser, "expected name:");
+		if (!read_text(parser, value)) return query_error(parser, "expected name text");
+		return ucd_index_match_names_containing(parser->index, value);
+	}
+
+	// A code point or range. The word reader stops at "..".
+	unichar low, high;
+	if (!parse_codepoint(word, &low)) {
+		parser->pos = term_start;
+		return query_error(parser, "expected property, name, or code point");
+	}
+	high = low;
+	if (parser->pos[0] == '.' && parser->pos[1] == '.') {
+		parser->pos += 2;
+		if (!read_word(parser, word) || !parse_codepoint(word, &high) || high < low)
+			return query_error(parser, "expected end of range");
+	}
+
+	codepoint_set * set = codepoint_set_new();
+	if (set != NULL && !codepoint_set_add_range(set, low, high))
+		codepoint_set_free(&set);
+	return set;
+}
+
+static codepoint_set * parse_not (query_parser * parser) {
+	codepoint_set * operand, * result;
+
+	if (accept(parser, '!')) {
+		if ((operand = parse_not(parser)) == NULL) return NULL;
+		result = codepoint_set_not(operand);
+		codepoint_set_free(&operand);
+		return result;
+	}
+	else if (accept(parser, '(')) {
+		if ((result = parse_or(parser)) != NULL && !accept(parser, ')')) {
+			codepoint_set_free(&result);
+			return query_error(parser, "expected )");
+		}
+		return result;
+	}
+
+	result = parse_term(parser);
+	skip_space(parser);
+	return result;
+}
+
+#define DEFINE_BINARY_PARSER(name, operand_parser, operator, combine) \
+	static codepoint_set * name (query_parser * parser) { \
+		codepoint_set * result = operand_parser(parser), * operand, * combined; \
+		while (result != NULL && accept(parser, operator)) { \
+			if ((operand = operand_parser(parser)) == NULL) { \
+				codepoint_set_free(&result); break; \
+			} \
+			combined = combine(result, operand); \
+			codepoint_set_free(&result), codepoint_set_free(&operand); \
+			result = combined; \
+		} \
+		return result; \
+	}
+
+DEFINE_BINARY_PARSER(parse_and, parse_not, '&', codepoint_set_and)
+DEFINE_BINARY_PARSER(parse_or, parse_and, '|', codepoint_set_or)
+
+codepoint_set * query_evaluate (const ucd_index * index, const char * query) {
+	query_parser parser = { index, query, query, false };
+
+	skip_space(&parser);
+	codepoint_set * result = parse_or(&parser);
+	if (result != NULL && *parser.pos != '\0') {
+		codepoint_set_free(&result);
+		return query_error(&parser, "unexpected character");
+	}
+	if (result == NULL) query_error(&parser, "query failed");
+#ifdef UCD_SUBSET
+	// Negations and code point ranges reach outside the subset.
+	else {
+		codepoint_set * in_subset = codepoint_set_and(result, index->subset);
+		codepoint_set_free(&result);
+		result = in_subset;
+	}
+#endif
+
+	return result;
+}
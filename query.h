@@ -0,0 +1,23 @@
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "ucd_index.h"
+#include "codepoint_set.h"
+
+// Evaluates a query over the code space and returns the set of matching
+// code points, or NULL after printing an error.
+//
+// query    := or
+// or       := and ('|' and)*
+// and      := not ('&' not)*
+// not      := '!' not | '(' query ')' | term
+// term     := property '=' value   e.g. gc=Lu, gc=L, ccc=230, bc=R, dt=compat
+//           | 'name:' text          name or alias contains text,
+//                                   which may be quoted: name:"WITH TONOS"
+//           | codepoint ['..' codepoint]   e.g. 0370..03FF, U+1F00..U+1FFF
+//
+// Property terms are answered from the sets precomputed in the index;
+// name terms scan all names.
+codepoint_set * query_evaluate (const ucd_index * index, const char * query);
+
+#endif
@@ -0,0 +1,172 @@
+/*
+ *  Loads UCD files that assign values to ranges of code points.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "common.h"
+#include "range_table.h"
+#include "subset.h"
+
+#define FREE_AND_NULL(mem) (free(mem), (mem) = NULL)
+
+#define STAGE1_LEN (0x110000 >> RANGE_TABLE_SHIFT)
+
+const void * find_range (const void * ranges, size_t count, size_t size,
+						 unichar codepoint) {
+	size_t low = 0, high = count;
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		const unichar * range = (const unichar *) ((const char *) ranges + mid * size);
+		if (codepoint < range[0]) high = mid;
+		else if (codepoint > range[1]) low = mid + 1;
+		else return range;
+	}
+	return NULL;
+}
+
+static int intern_value (range_table * table, const char * value) {
+	for (size_t i = 0; i < table->value_count; ++i)
+		if (strcmp(table->values[i], value) == 0) return i;
+
+	if (table->value_count == UINT16_MAX) {
+		fputs("Too many distinct values in range table\n", stderr);
+		return -1;
+	}
+	char * * values = realloc(table->values, (table->value_count + 1) * sizeof *values);
+	if (values == NULL) {
+		perror(MEM_ERR); return -1;
+	}
+	table->values = values;
+	if ((values[table->value_count] = ASPRINTF("%s", value)) == NULL) return -1;
+	return table->value_count++;
+}
+
+// Parses "XXXX..YYYY ; Value # comment" in place.
+static bool parse_range_line (char * line, unichar * low, unichar * high, char * * value) {
+	char * end, * comment = strchr(line, '#');
+	if (comment != NULL) *comment = '\0';
+
+	*low = strtoul(line, &end, 16);
+	if (end == line) return false;
+	if (end[0] == '.' && end[1] == '.') *high = strtoul(end + 2, &end, 16);
+	else *high = *low;
+
+	while (isspace((unsigned char) *end)) ++end;
+	if (*end++ != ';') return false;
+	while (isspace((unsigned char) *end)) ++end;
+
+	*value = end;
+	end += strlen(end);
+	while (end > *value && isspace((unsigned char) end[-1])) --end;
+	*end = '\0';
+
+	return **value != '\0' && *low <= *high && CODEPOINT_VALID(*high);
+}
+
+static int compare_ranges (const void * p1, const void * p2) {
+	unichar a = ((const range_entry *) p1)->low, b = ((const range_entry *) p2)->low;
+	return (a > b) - (a < b);
+}
+
+static bool read_ranges (range_table * table, FILE * file) {
+	static char line[BUFSIZ + 1];
+	size_t size = 0;
+	unichar low, high;
+	char * value;
+
+	rewind(file);
+
+	while (read_line(file, line, BUFSIZ) != EOF) {
+		if (!parse_range_line(line, &low, &high, &value)
+				|| !ucd_subset_intersects(low, high))
+			continue;
+
+		int value_index = intern_value(table, value);
+		if (value_index < 0) return false;
+
+		if (table->range_count == size) {
+			size = size == 0 ? 256 : size * 2;
+			range_entry * ranges = realloc(table->ranges, size * sizeof *ranges);
+			MEM_ERR_RETURN_FALSE(ranges);
+			table->ranges = ranges;
+		}
+		table->ranges[table->range_count++] = (range_entry) { low, high, value_index };
+	}
+
+	// Scripts.txt is ordered by script, not by code point.
+	qsort(table->ranges, table->range_count, sizeof *table->ranges, compare_ranges);
+	return true;
+}
+
+// Fills the trie one block of RANGE_TABLE_BLOCK_SIZE code points at a time,
+// reusing an earlier block of stage2 if one has the same contents.
+static bool build_trie (range_table * table) {
+	uint16_t block[RANGE_TABLE_BLOCK_SIZE];
+	size_t block_count = 0, size = 16, next_range = 0;
+
+	table->stage1 = malloc(STAGE1_LEN * sizeof *table->stage1);
+	table->stage2 = malloc(size * RANGE_TABLE_BLOCK_SIZE * sizeof *table->stage2);
+	MEM_ERR_RETURN_FALSE(table->stage1);
+	MEM_ERR_RETURN_FALSE(table->stage2);
+
+	for (size_t i = 0; i < STAGE1_LEN; ++i) {
+		unichar first = i << RANGE_TABLE_SHIFT;
+
+		for (unichar cp = 0; cp < RANGE_TABLE_BLOCK_SIZE; ++cp) {
+			while (next_range < table->range_count
+					&& table->ranges[next_range].high < first + cp)
+				++next_range;
+			block[cp] = next_range < table->range_count
+					&& table->ranges[next_range].low <= first + cp
+				? table->ranges[next_range].value : 0;
+		}
+
+		size_t j = 0;
+		while (j < block_count && memcmp(table->stage2 + j * RANGE_TABLE_BLOCK_SIZE,
+				block, sizeof block) != 0)
+			++j;
+
+		if (j == block_count) {
+			if (block_count == size) {
+				size *= 2;
+				uint16_t * stage2 = realloc(table->stage2,
+					size * RANGE_TABLE_BLOCK_SIZE * sizeof *stage2);
+				MEM_ERR_RETURN_FALSE(stage2);
+				table->stage2 = stage2;
+			}
+			memcpy(table->stage2 + block_count++ * RANGE_TABLE_BLOCK_SIZE,
+				block, sizeof block);
+		}
+		table->stage1[i] = j;
+	}
+
+	return true;
+}
+
+range_table * range_table_load (FILE * file, const char * default_value) {
+	range_table * table = calloc(1, sizeof *table);
+	MEM_ERR_RETURN_NULL(table);
+
+	if (intern_value(table, default_value) != 0
+			|| !read_ranges(table, file)
+			|| !build_trie(table))
+		range_table_free(&table);
+
+	return table;
+}
+
+void range_table_free (range_table * * table) {
+	if (*table != NULL) {
+		for (size_t i = 0; i < (*table)->value_count; ++i)
+			free((*table)->values[i]);
+		FREE_AND_NULL((*table)->values);
+		FREE_AND_NULL((*table)->ranges);
+		FREE_AND_NULL((*table)->stage1);
+		FREE_AND_NULL((*table)->stage2);
+		FREE_AND_NULL(*table);
+	}
+}
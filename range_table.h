@@ -0,0 +1,49 @@
+#ifndef RANGE_TABLE_H
+#define RANGE_TABLE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "unicodename.h"
+
+// Binary search in a sorted array of non-overlapping ranges, which are
+// structs of size size whose first members are unichar low, high.
+// Returns the range that contains codepoint, or NULL.
+const void * find_range (const void * ranges, size_t count, size_t size,
+						 unichar codepoint);
+
+typedef struct range_entry {
+	unichar low, high;
+	uint16_t value;
+} range_entry;
+
+// A UCD file of lines "XXXX..YYYY ; Value # comment" or "XXXX ; Value",
+// such as Blocks.txt or Scripts.txt, compiled into a sorted interval array
+// and a two-stage trie: stage1 maps the top bits of a code point to a
+// block of stage2, which holds the value index of each code point in it.
+// Identical blocks are stored once.
+typedef struct range_table {
+	range_entry * ranges;
+	size_t range_count;
+	char * * values; // values[0] is the default for unlisted code points
+	size_t value_count;
+	uint16_t * stage1, * stage2;
+} range_table;
+
+// default_value is the value of code points that are not listed,
+// e.g. "No_Block" or "Unknown".
+range_table * range_table_load (FILE * file, const char * default_value);
+
+void range_table_free (range_table * * table);
+
+#define RANGE_TABLE_SHIFT 8
+#define RANGE_TABLE_BLOCK_SIZE (1 << RANGE_TABLE_SHIFT)
+
+// Value of codepoint, which must be valid, from the trie.
+#define range_table_lookup(table, codepoint) \
+	((table)->values[(table)->stage2[ \
+		(table)->stage1[(codepoint) >> RANGE_TABLE_SHIFT] * RANGE_TABLE_BLOCK_SIZE \
+		+ ((codepoint) & (RANGE_TABLE_BLOCK_SIZE - 1))]])
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ *  The code points that a subset build covers.
+ */
+
+#include <stddef.h>
+
+#include "common.h"
+#include "subset.h"
+
+#ifdef UCD_SUBSET
+
+#define ARR_LEN(arr) (sizeof (arr) / sizeof *(arr))
+
+static const unichar subset_ranges[][2] = {
+#ifdef UCD_SUBSET_RANGES
+	UCD_SUBSET_RANGES
+#else
+	{ 0x0000, 0xFFFF }
+#endif
+};
+
+#ifdef UCD_SUBSET_BMP
+#  define SUBSET_MAX 0xFFFF
+#else
+#  define SUBSET_MAX 0x10FFFF
+#endif
+
+bool ucd_in_subset (unichar codepoint) {
+	if (!BETWEEN(codepoint, 0, SUBSET_MAX)) return false;
+	for (size_t i = 0; i < ARR_LEN(subset_ranges); ++i)
+		if (BETWEEN(codepoint, subset_ranges[i][0], subset_ranges[i][1]))
+			return true;
+	return false;
+}
+
+bool ucd_subset_range (size_t i, unichar * low, unichar * high) {
+	if (i >= ARR_LEN(subset_ranges)) return false;
+	*low = subset_ranges[i][0];
+	*high = subset_ranges[i][1] < SUBSET_MAX ? subset_ranges[i][1] : SUBSET_MAX;
+	return true;
+}
+
+bool ucd_subset_intersects (unichar low, unichar high) {
+	unichar subset_low, subset_high;
+	for (size_t i = 0; ucd_subset_range(i, &subset_low, &subset_high); ++i)
+		if (subset_low <= high && low <= subset_high && subset_low <= subset_high)
+			return true;
+	return false;
+}
+
+#endif
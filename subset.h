@@ -0,0 +1,33 @@
+#ifndef SUBSET_H
+#define SUBSET_H
+
+#include <stdbool.h>
+
+#include "unicodename.h"
+
+// A build can be limited to a subset of code points (see the Makefile):
+// UCD_SUBSET_BMP limits it to the Basic Multilingual Plane, and
+// UCD_SUBSET_RANGES, if defined, is an initializer list of { low, high }
+// pairs. With both, the subset is the ranges within the BMP. Data outside
+// the subset is not loaded, and code points outside it are named
+// <out-of-subset-XXXX>.
+#if defined UCD_SUBSET_BMP || defined UCD_SUBSET_RANGES
+#  define UCD_SUBSET
+
+bool ucd_in_subset (unichar codepoint);
+
+// Whether any code point from low to high is in the subset.
+bool ucd_subset_intersects (unichar low, unichar high);
+
+// Sets *low and *high to the ith range of the subset, which is empty
+// (*low > *high) if it lies outside the BMP in a BMP build. Returns false
+// if there are no more ranges.
+bool ucd_subset_range (size_t i, unichar * low, unichar * high);
+#else
+#  define ucd_in_subset(codepoint) true
+#  define ucd_subset_intersects(low, high) true
+#endif
+
+#define UCD_OUT_OF_SUBSET_FORMAT "<out-of-subset-%04X>"
+
+#endif
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Checks that expanding the output of --escape gives back the input,
+# including text that already contains "\N{", and that backslashes that do
+# not begin an escape pass through both filters unchanged.
+# Usage: test_escape.sh [path/to/unicodename [UCD directory]]
+# Without a directory, the one compiled into the program is used.
+
+exe=${1:-./unicodename}
+if [ -n "$2" ]; then
+	set -- -f "$2"
+else
+	set --
+fi
+
+if ! "$exe" "$@" 41 > /dev/null 2>&1; then
+	echo "SKIP: UnicodeData.txt not found; run make test UCD_DIR=<directory>"
+	exit 0
+fi
+
+dir=$(mktemp -d) || exit 2
+trap 'rm -rf "$dir"' EXIT
+
+status=0
+fail () { echo "FAIL: $*"; status=1; }
+
+# "\N{EURO SIGN}", "\\N{", "\N{\N{", "\N{U+005C}", "\é", "é\", a trailing
+# backslash, a control character, and a byte that is not valid UTF-8.
+printf '%s\n' \
+	'a literal \N{EURO SIGN} and \\N{ and \N{\N{U+0041} and \N{U+005C}N{' \
+	"$(printf 'caf\\\303\251 \303\251\\ \342\202\254\\\\')" \
+	"$(printf 'bell \007\\\007 and \377\\')" \
+	'ends with a backslash \' > "$dir/input"
+# A "\N{" split between two reads of the escape filter.
+head -c 65535 /dev/zero | tr '\0' x >> "$dir/input"
+printf '\\N{EURO SIGN}\n' >> "$dir/input"
+
+for which in nonascii nonprint; do
+	if ! "$exe" "$@" --escape=$which < "$dir/input" > "$dir/escaped" \
+			|| ! "$exe" "$@" --expand < "$dir/escaped" > "$dir/output" 2> /dev/null; then
+		fail "--escape=$which | --expand exited with an error"
+	elif cmp -s "$dir/input" "$dir/output"; then
+		echo "ok: --escape=$which | --expand"
+	else
+		fail "--escape=$which | --expand does not give back the input"
+	fi
+done
+
+# Only \N{...} escapes are rewritten.
+printf '%s\n' 'C:\\path {"a": "\\n"} \d+ \\ \N \' > "$dir/plain"
+for option in --escape --expand; do
+	if "$exe" "$@" $option < "$dir/plain" 2> /dev/null | cmp -s "$dir/plain" -; then
+		echo "ok: $option leaves other backslashes alone"
+	else
+		fail "$option changes backslashes that are not part of an escape"
+	fi
+done
+
+exit $status
@@ -0,0 +1,360 @@
+/*
+ *  Opens UCD files, optionally decompressing them from gzip files or zip
+ *  archives as they are read.
+ */
+
+#define _GNU_SOURCE // for fopencookie
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "common.h"
+#include "ucd_file.h"
+
+#if defined UCD_ZLIB && !(defined __GLIBC__ || defined __APPLE__ \
+	|| defined __FreeBSD__ || defined __NetBSD__ || defined __OpenBSD__)
+#  warning "No fopencookie or funopen; compressed UCD files are not supported."
+#  undef UCD_ZLIB
+#endif
+
+#ifdef UCD_ZLIB
+
+#include <zlib.h>
+
+#define ZIP_ARCHIVE_NAME "UCD.zip"
+
+#define ZIP_EOCD_SIGNATURE          0x06054b50
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014b50
+#define ZIP_LOCAL_HEADER_SIGNATURE  0x04034b50
+#define ZIP_EOCD_LEN                22
+#define ZIP_CENTRAL_HEADER_LEN      46
+#define ZIP_LOCAL_HEADER_LEN        30
+#define ZIP_MAX_COMMENT_LEN         0xFFFF
+
+#define ZIP_METHOD_STORED   0
+#define ZIP_METHOD_DEFLATED 8
+
+#define READ_U16(p) ((uint16_t) ((p)[0] | (p)[1] << 8))
+#define READ_U32(p) ((uint32_t) READ_U16(p) | (uint32_t) READ_U16((p) + 2) << 16)
+
+typedef struct zip_member {
+	FILE * archive;
+	long data_offset;
+	uint32_t compressed_size, consumed;
+	int method;
+	bool stream_end;
+	z_stream stream;
+	unsigned char in[BUFSIZ];
+	long pos;
+} zip_member;
+
+// COOKIE FUNCTIONS
+
+// The functions take and return the types that fopencookie and funopen
+// expect; cookie_read and cookie_seek convert to them.
+
+static long zip_member_read (zip_member * member, char * buf, size_t size) {
+	size_t remaining = member->compressed_size - member->consumed;
+
+	if (member->method == ZIP_METHOD_STORED) {
+		size_t read = fread(buf, 1, size < remaining ? size : remaining,
+			member->archive);
+		if (ferror(member->archive)) return -1;
+		member->consumed += read;
+		member->pos += read;
+		return read;
+	}
+
+	member->stream.next_out = (unsigned char *) buf;
+	member->stream.avail_out = size;
+	while (member->stream.avail_out > 0 && !member->stream_end) {
+		if (member->stream.avail_in == 0) {
+			size_t to_read = remaining < sizeof member->in
+				? remaining : sizeof member->in;
+			size_t read = fread(member->in, 1, to_read, member->archive);
+			if (read != to_read) { errno = EIO; return -1; }
+			member->consumed += read, remaining -= read;
+			member->stream.next_in = member->in;
+			member->stream.avail_in = read;
+		}
+
+		int status = inflate(&member->stream, Z_NO_FLUSH);
+		if (status == Z_STREAM_END)
+			member->stream_end = true;
+		else if (status != Z_OK) {
+			fprintf(stderr, "Failed to inflate zip member: %s\n",
+				member->stream.msg != NULL ? member->stream.msg : "unknown error");
+			errno = EIO;
+			return -1;
+		}
+	}
+
+	size_t produced = size - member->stream.avail_out;
+	member->pos += produced;
+	return produced;
+}
+
+static int zip_member_rewind (zip_member * member) {
+	if (fseek(member->archive, member->data_offset, SEEK_SET) != 0)
+		return -1;
+	member->consumed = 0;
+	member->pos = 0;
+	member->stream_end = false;
+	if (member->method == ZIP_METHOD_DEFLATED) {
+		member->stream.avail_in = 0;
+		if (inflateReset(&member->stream) != Z_OK) { errno = EIO; return -1; }
+	}
+	return 0;
+}
+
+// Only rewinding and telling the current position are supported, which is all
+// that the lookup functions need.
+static long zip_member_seek (zip_member * member, long offset, int whence) {
+	if (whence == SEEK_SET && offset == 0)
+		return zip_member_rewind(member);
+	else if (whence == SEEK_CUR && offset == 0)
+		return member->pos;
+
+	errno = ESPIPE;
+	return -1;
+}
+
+static int zip_member_close (zip_member * member) {
+	int status = 0;
+	if (member->method == ZIP_METHOD_DEFLATED)
+		inflateEnd(&member->stream);
+	status = fclose(member->archive);
+	free(member);
+	return status;
+}
+
+static long gz_read (gzFile gz, char * buf, size_t size) {
+	return gzread(gz, buf, size);
+}
+
+static long gz_seek (gzFile gz, long offset, int whence) {
+	return gzseek(gz, offset, whence);
+}
+
+static int gz_close (gzFile gz) {
+	return gzclose(gz) == Z_OK ? 0 : EOF;
+}
+
+#ifdef __GLIBC__
+
+#define DEFINE_COOKIE_FUNCTIONS(prefix, type) \
+	static ssize_t prefix##_cookie_read (void * cookie, char * buf, size_t size) { \
+		return prefix##_read((type) cookie, buf, size); \
+	} \
+	static int prefix##_cookie_seek (void * cookie, off64_t * offset, int whence) { \
+		long pos = prefix##_seek((type) cookie, *offset, whence); \
+		if (pos == -1) return -1; \
+		*offset = pos; \
+		return 0; \
+	} \
+	static int prefix##_cookie_close (void * cookie) { \
+		return prefix##_close((type) cookie); \
+	} \
+	static FILE * prefix##_fopen (type cookie) { \
+		static const cookie_io_functions_t functions = { \
+			prefix##_cookie_read, NULL, prefix##_cookie_seek, prefix##_cookie_close \
+		}; \
+		return fopencookie(cookie, "r", functions); \
+	}
+
+#else // BSD, macOS
+
+#define DEFINE_COOKIE_FUNCTIONS(prefix, type) \
+	static int prefix##_cookie_read (void * cookie, char * buf, int size) { \
+		return prefix##_read((type) cookie, buf, size); \
+	} \
+	static fpos_t prefix##_cookie_seek (void * cookie, fpos_t offset, int whence) { \
+		return prefix##_seek((type) cookie, offset, whence); \
+	} \
+	static int prefix##_cookie_close (void * cookie) { \
+		return prefix##_close((type) cookie); \
+	} \
+	static FILE * prefix##_fopen (type cookie) { \
+		return funopen(cookie, prefix##_cookie_read, NULL, \
+			prefix##_cookie_seek, prefix##_cookie_close); \
+	}
+
+#endif
+
+DEFINE_COOKIE_FUNCTIONS(zip_member, zip_member *)
+DEFINE_COOKIE_FUNCTIONS(gz, gzFile)
+
+// END COOKIE FUNCTIONS
+
+static FILE * open_gzip (const char * path) {
+	FILE * file = NULL;
+	char * gz_path = ASPRINTF("%s.gz", path);
+	if (gz_path == NULL) return NULL;
+
+	gzFile gz = gzopen(gz_path, "rb");
+	free(gz_path);
+	if (gz == NULL) return NULL;
+
+	gzbuffer(gz, 1 << 16);
+	file = gz_fopen(gz);
+	if (file == NULL) gzclose(gz);
+
+	return file;
+}
+
+// Finds the end of central directory record, which is followed only by the
+// archive comment, and reads the central directory offset and entry count.
+static bool zip_read_eocd (FILE * archive, long * cd_offset, int * entry_count) {
+	static unsigned char buf[ZIP_EOCD_LEN + ZIP_MAX_COMMENT_LEN];
+	long archive_len, buf_len;
+
+	if (fseek(archive, 0, SEEK_END) != 0 || (archive_len = ftell(archive)) < 0)
+		return false;
+
+	buf_len = archive_len < sizeof buf ? archive_len : (long) sizeof buf;
+	if (fseek(archive, archive_len - buf_len, SEEK_SET) != 0
+			|| fread(buf, 1, buf_len, archive) != buf_len)
+		return false;
+
+	for (long i = buf_len - ZIP_EOCD_LEN; i >= 0; --i) {
+		if (READ_U32(buf + i) == ZIP_EOCD_SIGNATURE) {
+			*entry_count = READ_U16(buf + i + 10);
+			*cd_offset = READ_U32(buf + i + 16);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// member_name matches either the whole name of an entry, or its last path
+// components, so that archives that put the files in a subdirectory work.
+static bool zip_entry_name_matches (const char * entry_name, size_t entry_name_len,
+									const char * member_name) {
+	size_t member_name_len = strlen(member_name);
+	if (entry_name_len < member_name_len) return false;
+	const char * tail = entry_name + entry_name_len - member_name_len;
+	return memcmp(tail, member_name, member_name_len) == 0
+		&& (tail == entry_name || tail[-1] == '/');
+}
+
+static FILE * open_zip_member (const char * archive_path, const char * member_name) {
+	unsigned char header[ZIP_CENTRAL_HEADER_LEN];
+	char entry_name[BUFSIZ];
+	long cd_offset;
+	int entry_count;
+	zip_member * member = NULL;
+	FILE * file = NULL;
+
+	FILE * archive = fopen(archive_path, "rb");
+	if (archive == NULL) return NULL;
+
+	if (!zip_read_eocd(archive, &cd_offset, &entry_count)
+			|| fseek(archive, cd_offset, SEEK_SET) != 0)
+		goto fail;
+
+	for (int i = 0; i < entry_count; ++i) {
+		if (fread(header, 1, ZIP_CENTRAL_HEADER_LEN, archive) != ZIP_CENTRAL_HEADER_LEN
+				|| READ_U32(header) != ZIP_CENTRAL_HEADER_SIGNATURE)
+			goto fail;
+
+		size_t name_len = READ_U16(header + 28);
+		long skip = READ_U16(header + 30) + READ_U16(header + 32);
+		if (name_len >= sizeof entry_name
+				|| fread(entry_name, 1, name_len, archive) != name_len)
+			goto fail;
+
+		if (zip_entry_name_matches(entry_name, name_len, member_name)) {
+			int method = READ_U16(header + 10);
+			if (method != ZIP_METHOD_STORED && method != ZIP_METHOD_DEFLATED) {
+				fprintf(stderr, "%s in %s uses unsupported compression method %d\n",
+					member_name, archive_path, method);
+				goto fail;
+			}
+
+			member = calloc(1, sizeof *member);
+			if (member == NULL) { perror(MEM_ERR); goto fail; }
+			member->archive = archive;
+			member->method = method;
+			member->compressed_size = READ_U32(header + 20);
+
+			// The data follows the local header, whose name and extra field
+			// lengths may differ from those in the central directory.
+			long local_offset = READ_U32(header + 42);
+			if (fseek(archive, local_offset, SEEK_SET) != 0
+					|| fread(header, 1, ZIP_LOCAL_HEADER_LEN, archive) != ZIP_LOCAL_HEADER_LEN
+					|| READ_U32(header) != ZIP_LOCAL_HEADER_SIGNATURE)
+				goto fail;
+			member->data_offset = local_offset + ZIP_LOCAL_HEADER_LEN
+				+ READ_U16(header + 26) + READ_U16(header + 28);
+
+			// Negative window bits: raw deflate data without zlib header.
+			if (method == ZIP_METHOD_DEFLATED
+					&& inflateInit2(&member->stream, -MAX_WBITS) != Z_OK)
+				goto fail;
+
+			if (zip_member_rewind(member) != 0
+					|| (file = zip_member_fopen(member)) == NULL) {
+				if (method == ZIP_METHOD_DEFLATED) inflateEnd(&member->stream);
+				goto fail;
+			}
+
+			return file;
+		}
+
+		if (fseek(archive, skip, SEEK_CUR) != 0) goto fail;
+	}
+
+fail:
+	free(member);
+	fclose(archive);
+	return NULL;
+}
+
+// Tries "dir/archive.zip/member" and then "dir/UCD.zip" with the last
+// component of path as member name.
+static FILE * open_from_zip (const char * path) {
+	FILE * file = NULL;
+	const char * last_slash = strrchr(path, '/');
+	if (last_slash == NULL || last_slash[1] == '\0') return NULL;
+
+	size_t dir_len = last_slash - path;
+	char * archive_path = ASPRINTF("%.*s", (int) dir_len, path);
+	if (archive_path == NULL) return NULL;
+
+	if (dir_len >= sizeof ".zip" - 1
+			&& strcmp(archive_path + dir_len - (sizeof ".zip" - 1), ".zip") == 0)
+		file = open_zip_member(archive_path, last_slash + 1);
+
+	if (file == NULL) {
+		char * zip_path = rasprintf(archive_path, "%.*s/" ZIP_ARCHIVE_NAME,
+			(int) dir_len, path);
+		if (zip_path == NULL) return NULL;
+		archive_path = zip_path;
+		file = open_zip_member(archive_path, last_slash + 1);
+	}
+
+	free(archive_path);
+	return file;
+}
+
+#endif // UCD_ZLIB
+
+FILE * ucd_fopen (const char * path) {
+	FILE * file = fopen(path, "r");
+
+#ifdef UCD_ZLIB
+	if (file == NULL) {
+		int fopen_errno = errno;
+
+		if ((file = open_gzip(path)) == NULL
+				&& (file = open_from_zip(path)) == NULL)
+			errno = fopen_errno;
+	}
+#endif
+
+	return file;
+}
@@ -0,0 +1,21 @@
+#ifndef UCD_FILE_H
+#define UCD_FILE_H
+
+#include <stdio.h>
+
+// Opens a Unicode Character Database file for reading.
+//
+// If the plain file cannot be opened and the program was built with zlib
+// (UCD_ZLIB), the file is looked for, in this order:
+// * gzipped, at path + ".gz"
+// * as a member of a zip archive, if a component of path names a zip file,
+//   as in "/usr/share/unicode/UCD.zip/UnicodeData.txt"
+// * as a member of UCD.zip in the same directory as path
+// Compressed data is decompressed as it is read, so nothing is written to
+// disk. The returned FILE * supports rewind, but not arbitrary seeking.
+//
+// Returns NULL with errno set by the attempt to open the plain file if the
+// file could not be found in any form.
+FILE * ucd_fopen (const char * path);
+
+#endif
@@ -0,0 +1,845 @@
+/*
+ *  Loads UnicodeData.txt and NameAliases.txt into memory, with a set of code
+ *  points for each property value.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h> // for strcasecmp
+#include <ctype.h>
+
+#include "common.h"
+#include "ucd_index.h"
+#include "range_table.h"
+#include "subset.h"
+
+#define ARR_LEN(arr) (sizeof (arr) / sizeof *(arr))
+#define FREE_AND_NULL(mem) (free(mem), (mem) = NULL)
+
+#define UNICODE_DATA_FIELD_COUNT UNICODE_DATA_SIMPLE_TITLECASE_MAPPING
+
+#define NO_VALUE 0xFF
+
+// Marks full decompositions that have not been computed yet.
+#define NOT_EXPANDED UINT8_MAX
+
+// Hangul syllable decomposition, from chapter 3 of the Unicode standard.
+#define HANGUL_S_BASE  0xAC00
+#define HANGUL_L_BASE  0x1100
+#define HANGUL_V_BASE  0x1161
+#define HANGUL_T_BASE  0x11A7
+#define HANGUL_T_COUNT 28
+#define HANGUL_N_COUNT (21 * HANGUL_T_COUNT)
+#define HANGUL_S_COUNT (19 * HANGUL_N_COUNT)
+#define IS_HANGUL_SYLLABLE(codepoint) \
+	BETWEEN((codepoint), HANGUL_S_BASE, HANGUL_S_BASE + HANGUL_S_COUNT - 1)
+
+// PROPERTY VALUES
+
+static const char * const general_categories[] = {
+	"Lu", "Ll", "Lt", "Lm", "Lo", "Mn", "Mc", "Me", "Nd", "Nl", "No",
+	"Pc", "Pd", "Ps", "Pe", "Pi", "Pf", "Po", "Sm", "Sc", "Sk", "So",
+	"Zs", "Zl", "Zp", "Cc", "Cf", "Cs", "Co", "Cn"
+};
+#define GENERAL_CATEGORY_CN (ARR_LEN(general_categories) - 1)
+
+static const char * const bidi_classes[] = {
+	"L", "R", "AL", "EN", "ES", "ET", "AN", "CS", "NSM", "BN", "B", "S", "WS",
+	"ON", "LRE", "LRO", "RLE", "RLO", "PDF", "LRI", "RLI", "FSI", "PDI"
+};
+
+// Short names and the tags used in UnicodeData.txt.
+// Index 1 is canonical decomposition, which has no tag.
+static const char * const decomposition_types[][2] = {
+	{ "None", "" },      { "can", "" },          { "com", "compat" },
+	{ "enc", "circle" }, { "fin", "final" },     { "font", "font" },
+	{ "fra", "fraction" }, { "init", "initial" }, { "iso", "isolated" },
+	{ "med", "medial" }, { "nar", "narrow" },    { "nb", "noBreak" },
+	{ "sml", "small" },  { "sqr", "square" },    { "sub", "sub" },
+	{ "sup", "super" },  { "vert", "vertical" }, { "wide", "wide" }
+};
+#define DECOMPOSITION_TYPE_NONE      0
+#define DECOMPOSITION_TYPE_CANONICAL 1
+
+static const char * const numeric_types[] = { "None", "De", "Di", "Nu" };
+
+static const char * const property_names[UCD_PROPERTY_COUNT][2] = {
+	[UCD_PROPERTY_GENERAL_CATEGORY]   = { "gc",  "General_Category" },
+	[UCD_PROPERTY_BIDI_CLASS]         = { "bc",  "Bidi_Class" },
+	[UCD_PROPERTY_COMBINING_CLASS]    = { "ccc", "Canonical_Combining_Class" },
+	[UCD_PROPERTY_DECOMPOSITION_TYPE] = { "dt",  "Decomposition_Type" },
+	[UCD_PROPERTY_NUMERIC_TYPE]       = { "nt",  "Numeric_Type" },
+	[UCD_PROPERTY_BIDI_MIRRORED]      = { "Bidi_M", "Bidi_Mirrored" }
+};
+
+static int find_value (const char * const * values, size_t count, const char * value) {
+	for (size_t i = 0; i < count; ++i)
+		if (strcasecmp(values[i], value) == 0) return i;
+	return -1;
+}
+
+enum ucd_property ucd_property_from_name (const char * name) {
+	for (int i = 0; i < UCD_PROPERTY_COUNT; ++i)
+		if (strcasecmp(property_names[i][0], name) == 0
+				|| strcasecmp(property_names[i][1], name) == 0)
+			return i;
+	if (strcasecmp(name, "mirrored") == 0) return UCD_PROPERTY_BIDI_MIRRORED;
+	return -1;
+}
+
+int ucd_property_value_from_name (enum ucd_property property, const char * value) {
+	switch (property) {
+		case UCD_PROPERTY_GENERAL_CATEGORY:
+			return find_value(general_categories, ARR_LEN(general_categories), value);
+		case UCD_PROPERTY_BIDI_CLASS:
+			return find_value(bidi_classes, ARR_LEN(bidi_classes), value);
+		case UCD_PROPERTY_COMBINING_CLASS: {
+			char * end;
+			long ccc = strtol(value, &end, 10);
+			return *value != '\0' && *end == '\0' && BETWEEN(ccc, 0, 254) ? ccc : -1;
+		}
+		case UCD_PROPERTY_DECOMPOSITION_TYPE:
+			for (size_t i = 0; i < ARR_LEN(decomposition_types); ++i)
+				if (strcasecmp(decomposition_types[i][0], value) == 0
+						|| (i > DECOMPOSITION_TYPE_CANONICAL
+						&& strcasecmp(decomposition_types[i][1], value) == 0))
+					return i;
+			return -1;
+		case UCD_PROPERTY_NUMERIC_TYPE:
+			return find_value(numeric_types, ARR_LEN(numeric_types), value);
+		case UCD_PROPERTY_BIDI_MIRRORED:
+			if (strcasecmp(value, "Y") == 0 || strcasecmp(value, "Yes") == 0) return 1;
+			if (strcasecmp(value, "N") == 0 || strcasecmp(value, "No") == 0) return 0;
+			return -1;
+		default:
+			return -1;
+	}
+}
+
+const char * ucd_property_value_name (enum ucd_property property, int value) {
+	static char ccc[sizeof "255"];
+	switch (property) {
+		case UCD_PROPERTY_GENERAL_CATEGORY:
+			return BETWEEN(value, 0, ARR_LEN(general_categories) - 1)
+				? general_categories[value] : NULL;
+		case UCD_PROPERTY_BIDI_CLASS:
+			return BETWEEN(value, 0, ARR_LEN(bidi_classes) - 1)
+				? bidi_classes[value] : NULL;
+		case UCD_PROPERTY_COMBINING_CLASS:
+			if (!BETWEEN(value, 0, 254)) return NULL;
+			sprintf(ccc, "%d", value);
+			return ccc;
+		case UCD_PROPERTY_DECOMPOSITION_TYPE:
+			return BETWEEN(value, 0, ARR_LEN(decomposition_types) - 1)
+				? decomposition_types[value][0] : NULL;
+		case UCD_PROPERTY_NUMERIC_TYPE:
+			return BETWEEN(value, 0, ARR_LEN(numeric_types) - 1)
+				? numeric_types[value] : NULL;
+		case UCD_PROPERTY_BIDI_MIRRORED:
+			return value == 1 ? "Y" : value == 0 ? "N" : NULL;
+		default:
+			return NULL;
+	}
+}
+
+static uint8_t parse_decomposition_type (const char * mapping) {
+	if (mapping[0] == '\0') return DECOMPOSITION_TYPE_NONE;
+	else if (mapping[0] != '<') return DECOMPOSITION_TYPE_CANONICAL;
+
+	const char * tag_end = strchr(mapping, '>');
+	if (tag_end != NULL) {
+		size_t tag_len = tag_end - (mapping + 1);
+		for (size_t i = DECOMPOSITION_TYPE_CANONICAL + 1; i < ARR_LEN(decomposition_types); ++i)
+			if (strlen(decomposition_types[i][1]) == tag_len
+					&& strncmp(decomposition_types[i][1], mapping + 1, tag_len) == 0)
+				return i;
+	}
+	return NO_VALUE;
+}
+
+const char * ucd_decomposition_tag (int type) {
+	return BETWEEN(type, DECOMPOSITION_TYPE_CANONICAL, ARR_LEN(decomposition_types) - 1)
+		? decomposition_types[type][1] : NULL;
+}
+
+// END PROPERTY VALUES
+
+// LOADING
+
+typedef struct index_builder {
+	ucd_index * index;
+	size_t records_size, strings_size, decompositions_size;
+} index_builder;
+
+static uint32_t add_string (index_builder * builder, const char * str, size_t len) {
+	ucd_index * index = builder->index;
+	if (index->strings_len + len + 1 > builder->strings_size) {
+		size_t size = builder->strings_size == 0 ? BUFSIZ : builder->strings_size;
+		while (size < index->strings_len + len + 1) size *= 2;
+		char * strings = realloc(index->strings, size);
+		if (strings == NULL) { perror(MEM_ERR); return UCD_NO_STRING; }
+		index->strings = strings;
+		builder->strings_size = size;
+	}
+	uint32_t offset = index->strings_len;
+	memcpy(index->strings + offset, str, len);
+	index->strings[offset + len] = '\0';
+	index->strings_len += len + 1;
+	return offset;
+}
+
+static uint32_t add_codepoints (index_builder * builder, const unichar * codepoints,
+								size_t len) {
+	ucd_index * index = builder->index;
+	if (index->decompositions_len + len > builder->decompositions_size) {
+		size_t size = builder->decompositions_size == 0 ? BUFSIZ : builder->decompositions_size;
+		while (size < index->decompositions_len + len) size *= 2;
+		unichar * decompositions = realloc(index->decompositions, size * sizeof *decompositions);
+		if (decompositions == NULL) { perror(MEM_ERR); return UINT32_MAX; }
+		index->decompositions = decompositions;
+		builder->decompositions_size = size;
+	}
+	uint32_t offset = index->decompositions_len;
+	memcpy(index->decompositions + offset, codepoints, len * sizeof *codepoints);
+	index->decompositions_len += len;
+	return offset;
+}
+
+static ucd_record * add_record (index_builder * builder) {
+	ucd_index * index = builder->index;
+	if (index->record_count == builder->records_size) {
+		size_t size = builder->records_size == 0 ? 1024 : builder->records_size * 2;
+		ucd_record * records = realloc(index->records, size * sizeof *records);
+		MEM_ERR_RETURN_NULL(records);
+		index->records = records;
+		builder->records_size = size;
+	}
+	return &index->records[index->record_count++];
+}
+
+// Splits line at semicolons in place. Returns the number of fields.
+static int split_fields (char * line, char * * fields, int max_fields) {
+	int count = 0;
+	fields[count++] = line;
+	for (char * p = line; *p != '\0' && count < max_fields; ++p)
+		if (*p == ';') *p = '\0', fields[count++] = p + 1;
+	return count;
+}
+
+#define FIELD(fields, field) ((fields)[(field) - 1])
+
+#ifdef UCD_SUBSET
+static codepoint_set * make_subset_set (void) {
+	codepoint_set * subset = codepoint_set_new();
+	unichar low, high;
+	if (subset == NULL) return NULL;
+	for (size_t i = 0; ucd_subset_range(i, &low, &high); ++i)
+		if (low <= high && !codepoint_set_add_range(subset, low, high)) {
+			codepoint_set_free(&subset); return NULL;
+		}
+	return subset;
+}
+
+// Replaces the last record, a range, with a record for each run of the
+// subset within it, so that no record covers code points outside the subset.
+static bool clip_range_record (index_builder * builder) {
+	ucd_index * index = builder->index;
+	ucd_record range = index->records[--index->record_count];
+	unichar low, high;
+
+	for (unichar from = range.low; from <= range.high
+			&& codepoint_set_next_range(index->subset, from, &low, &high)
+			&& low <= range.high; from = high + 1) {
+		ucd_record * record = add_record(builder);
+		if (record == NULL) return false;
+		*record = range;
+		record->low = low;
+		record->high = high < range.high ? high : range.high;
+	}
+	return true;
+}
+#endif
+
+// Stores the code points of a mapping like "<compat> 0020 0301".
+static bool parse_decomposition (index_builder * builder, ucd_record * record,
+								 const char * mapping) {
+	unichar codepoints[UCD_MAX_DECOMPOSITION_LEN];
+	size_t len = 0;
+	char * end;
+
+	record->decomposition_len = record->canonical_len = record->compatibility_len = 0;
+
+	const char * tag_end = mapping[0] == '<' ? strchr(mapping, '>') : NULL;
+	if (tag_end != NULL) mapping = tag_end + 1;
+
+	while (len < UCD_MAX_DECOMPOSITION_LEN
+			&& (codepoints[len] = strtoul(mapping, &end, 16), end != mapping)) {
+		++len;
+		mapping = end;
+	}
+	if (len == 0) return true;
+
+	record->decomposition = add_codepoints(builder, codepoints, len);
+	if (record->decomposition == UINT32_MAX) return false;
+	record->decomposition_len = len;
+	record->canonical_len = record->compatibility_len = NOT_EXPANDED;
+	return true;
+}
+
+static bool load_Unicode_data (index_builder * builder, FILE * Unicode_Data_txt) {
+	static char line[BUFSIZ + 1];
+	char * fields[UNICODE_DATA_FIELD_COUNT];
+	ucd_record * range_start = NULL;
+
+	rewind(Unicode_Data_txt);
+
+	while (read_line(Unicode_Data_txt, line, BUFSIZ) != EOF) {
+		if (line[0] == '\0') continue;
+		if (split_fields(line, fields, UNICODE_DATA_FIELD_COUNT) < UNICODE_DATA_BIDI_MIRRORED) {
+			fprintf(stderr, "Too few fields in UnicodeData.txt line for %s\n", line);
+			continue;
+		}
+
+		unichar codepoint = strtoul(FIELD(fields, UNICODE_DATA_CODEPOINT_FIELD), NULL, 16);
+		const char * name = FIELD(fields, UNICODE_DATA_NAME);
+		bool range_first = name[0] == '<' && strstr(name, ", First>") != NULL,
+			range_last = range_start != NULL && name[0] == '<'
+				&& strstr(name, ", Last>") != NULL;
+
+		// In a subset build, lines outside the subset are left out.
+		if (range_last && !ucd_subset_intersects(range_start->low, codepoint)) {
+			--builder->index->record_count;
+			range_start = NULL;
+			continue;
+		}
+		if (!range_first && !range_last && !ucd_in_subset(codepoint)) continue;
+
+		// The second line of a range supplies the end and the name, as in
+		// get_codepoint_names, so the first line's name is not stored: the
+		// range may still be left out of a subset.
+		uint32_t name_offset = UCD_NO_STRING;
+		if (!range_first
+				&& (name_offset = add_string(builder, name, strlen(name))) == UCD_NO_STRING)
+			return false;
+
+		if (range_last) {
+			range_start->high = codepoint;
+			range_start->name = name_offset;
+			range_start = NULL;
+#ifdef UCD_SUBSET
+			if (!clip_range_record(builder)) return false;
+#endif
+			continue;
+		}
+
+		ucd_record * record = add_record(builder);
+		if (record == NULL) return false;
+
+		record->low = record->high = codepoint;
+		record->name = name_offset;
+		record->aliases = UCD_NO_STRING;
+		record->general_category = find_value(general_categories,
+			ARR_LEN(general_categories), FIELD(fields, UNICODE_DATA_GENERAL_CATEGORY));
+		record->bidi_class = find_value(bidi_classes, ARR_LEN(bidi_classes),
+			FIELD(fields, UNICODE_DATA_BIDI_CLASS));
+		record->combining_class =
+			atoi(FIELD(fields, UNICODE_DATA_CANONICAL_COMBINING_CLASS));
+		record->decomposition_type = parse_decomposition_type(
+			FIELD(fields, UNICODE_DATA_DECOMPOSITION_TYPE_OR_MAPPING));
+		if (!parse_decomposition(builder, record,
+				FIELD(fields, UNICODE_DATA_DECOMPOSITION_TYPE_OR_MAPPING)))
+			return false;
+		record->numeric_type =
+			FIELD(fields, UNICODE_DATA_NUMERIC_TYPE_DECIMAL)[0] != '\0' ? 1
+			: FIELD(fields, UNICODE_DATA_NUMERIC_TYPE_DIGIT)[0] != '\0' ? 2
+			: FIELD(fields, UNICODE_DATA_NUMERIC_TYPE_NUMERIC)[0] != '\0' ? 3 : 0;
+		record->mirrored = FIELD(fields, UNICODE_DATA_BIDI_MIRRORED)[0] == 'Y';
+
+		range_start = range_first ? record : NULL;
+	}
+
+	return true;
+}
+
+// Computes the full decomposition of a record from the full decompositions
+// of the code points in its mapping, which are computed first if they have
+// not been. A full decomposition that is the same as the mapping shares
+// its code points.
+static bool expand_decomposition (index_builder * builder, ucd_record * record,
+								  bool compatibility) {
+	ucd_index * index = builder->index;
+	uint8_t * len = compatibility ? &record->compatibility_len : &record->canonical_len;
+	uint32_t * offset = compatibility ? &record->compatibility : &record->canonical;
+	unichar mapping[UCD_MAX_DECOMPOSITION_LEN], expanded[UCD_MAX_DECOMPOSITION_LEN];
+	size_t expanded_len = 0;
+
+	if (*len != NOT_EXPANDED) return true;
+	*len = 0;
+	if (!compatibility && record->decomposition_type != DECOMPOSITION_TYPE_CANONICAL)
+		return true;
+
+	// Expanding other records may move the code points.
+	memcpy(mapping, index->decompositions + record->decomposition,
+		record->decomposition_len * sizeof *mapping);
+
+	for (size_t i = 0; i < record->decomposition_len; ++i) {
+		ucd_record * part = (ucd_record *) ucd_index_find(index, mapping[i]);
+		const unichar * part_codepoints = &mapping[i];
+		size_t part_len = 1;
+
+		if (part != NULL && part->decomposition_len > 0) {
+			if (!expand_decomposition(builder, part, compatibility)) return false;
+			if ((compatibility ? part->compatibility_len : part->canonical_len) > 0) {
+				part_codepoints = index->decompositions
+					+ (compatibility ? part->compatibility : part->canonical);
+				part_len = compatibility ? part->compatibility_len : part->canonical_len;
+			}
+		}
+
+		if (expanded_len + part_len > UCD_MAX_DECOMPOSITION_LEN) {
+			fprintf(stderr, "Decomposition of U+%04X is too long\n", record->low);
+			return false;
+		}
+		memcpy(expanded + expanded_len, part_codepoints, part_len * sizeof *expanded);
+		expanded_len += part_len;
+	}
+
+	if (expanded_len == record->decomposition_len
+			&& memcmp(expanded, mapping, expanded_len * sizeof *expanded) == 0)
+		*offset = record->decomposition;
+	else if ((*offset = add_codepoints(builder, expanded, expanded_len)) == UINT32_MAX)
+		return false;
+	*len = expanded_len;
+	return true;
+}
+
+static bool expand_decompositions (index_builder * builder) {
+	for (size_t i = 0; i < builder->index->record_count; ++i) {
+		ucd_record * record = &builder->index->records[i];
+		if (!expand_decomposition(builder, record, false)
+				|| !expand_decomposition(builder, record, true))
+			return false;
+	}
+	return true;
+}
+
+static bool attach_aliases (index_builder * builder, unichar codepoint,
+							const char * aliases, size_t len) {
+	ucd_record * record = (ucd_record *) ucd_index_find(builder->index, codepoint);
+	if (record == NULL) return true; // No name to attach aliases to.
+	record->aliases = add_string(builder, aliases, len);
+	return record->aliases != UCD_NO_STRING;
+}
+
+// Aliases of each code point are joined in the order of the file, which is
+// sorted by code point.
+static bool load_aliases (index_builder * builder, FILE * Name_Aliases_txt) {
+	static char line[BUFSIZ + 1], joined[BUFSIZ + 1];
+	char * fields[3];
+	size_t joined_len = 0;
+	unichar joined_codepoint = 0;
+
+	rewind(Name_Aliases_txt);
+
+	while (read_line(Name_Aliases_txt, line, BUFSIZ) != EOF) {
+		if (!isxdigit(line[0]) || split_fields(line, fields, 3) < 2) continue;
+
+		unichar codepoint = strtoul(fields[0], NULL, 16);
+		if (joined_len > 0 && codepoint != joined_codepoint) {
+			if (!attach_aliases(builder, joined_codepoint, joined, joined_len))
+				return false;
+			joined_len = 0;
+		}
+
+		int len = snprintf(joined + joined_len, sizeof joined - joined_len, "%s%s",
+			joined_len > 0 ? ", " : "", fields[1]);
+		if (len > 0 && joined_len + len < sizeof joined) joined_len += len;
+		joined_codepoint = codepoint;
+	}
+
+	return joined_len == 0
+		|| attach_aliases(builder, joined_codepoint, joined, joined_len);
+}
+
+static bool add_to_property_set (ucd_index * index, enum ucd_property property,
+								 uint8_t value, const ucd_record * record) {
+	if (value == NO_VALUE) return true;
+	codepoint_set * * set = &index->property_sets[property][value];
+	if (*set == NULL && (*set = codepoint_set_new()) == NULL) return false;
+	return codepoint_set_add_range(*set, record->low, record->high);
+}
+
+static bool build_property_sets (ucd_index * index) {
+	if ((index->assigned = codepoint_set_new()) == NULL) return false;
+
+	for (size_t i = 0; i < index->record_count; ++i) {
+		const ucd_record * record = &index->records[i];
+		if (!codepoint_set_add_range(index->assigned, record->low, record->high)
+				|| !add_to_property_set(index, UCD_PROPERTY_GENERAL_CATEGORY,
+					record->general_category, record)
+				|| !add_to_property_set(index, UCD_PROPERTY_BIDI_CLASS,
+					record->bidi_class, record)
+				|| !add_to_property_set(index, UCD_PROPERTY_COMBINING_CLASS,
+					record->combining_class, record)
+				|| !add_to_property_set(index, UCD_PROPERTY_DECOMPOSITION_TYPE,
+					record->decomposition_type, record)
+				|| !add_to_property_set(index, UCD_PROPERTY_NUMERIC_TYPE,
+					record->numeric_type, record)
+				|| !add_to_property_set(index, UCD_PROPERTY_BIDI_MIRRORED,
+					record->mirrored, record))
+			return false;
+	}
+
+	codepoint_set * * unassigned =
+		&index->property_sets[UCD_PROPERTY_GENERAL_CATEGORY][GENERAL_CATEGORY_CN];
+	if ((*unassigned = codepoint_set_not(index->assigned)) == NULL) return false;
+
+#ifdef UCD_SUBSET
+	// Nothing is known about code points outside the subset.
+	codepoint_set * unassigned_in_subset = codepoint_set_and(*unassigned, index->subset);
+	codepoint_set_free(unassigned);
+	*unassigned = unassigned_in_subset;
+#endif
+
+	return *unassigned != NULL;
+}
+
+ucd_index * ucd_index_load (FILE * Unicode_Data_txt, FILE * Name_Aliases_txt) {
+	index_builder builder = { NULL, 0, 0, 0 };
+
+	builder.index = calloc(1, sizeof *builder.index);
+	MEM_ERR_RETURN_NULL(builder.index);
+#ifdef UCD_SUBSET
+	if ((builder.index->subset = make_subset_set()) == NULL) {
+		ucd_index_free(&builder.index); return NULL;
+	}
+#endif
+
+	if (!load_Unicode_data(&builder, Unicode_Data_txt)
+			|| !expand_decompositions(&builder)
+			|| (Name_Aliases_txt != NULL && !load_aliases(&builder, Name_Aliases_txt))
+			|| !build_property_sets(builder.index))
+		ucd_index_free(&builder.index);
+
+	return builder.index;
+}
+
+void ucd_index_free (ucd_index * * index) {
+	if (*index != NULL) {
+		FREE_AND_NULL((*index)->records);
+		FREE_AND_NULL((*index)->strings);
+		FREE_AND_NULL((*index)->decompositions);
+		codepoint_set_free(&(*index)->assigned);
+		codepoint_set_free(&(*index)->subset);
+		for (int i = 0; i < UCD_PROPERTY_COUNT; ++i)
+			for (int j = 0; j < UCD_MAX_PROPERTY_VALUES; ++j)
+				codepoint_set_free(&(*index)->property_sets[i][j]);
+		FREE_AND_NULL(*index);
+	}
+}
+
+// END LOADING
+
+const ucd_record * ucd_index_find (const ucd_index * index, unichar codepoint) {
+	return find_range(index->records, index->record_count, sizeof *index->records,
+		codepoint);
+}
+
+// Hangul syllables have canonical decompositions into an LV syllable and a
+// trailing consonant, or into a leading consonant and a vowel.
+static bool decompose_Hangul_syllable (unichar codepoint, bool full,
+									   ucd_decomposition * decomposition) {
+	unichar syllable_index = codepoint - HANGUL_S_BASE;
+	unichar trail_index = syllable_index % HANGUL_T_COUNT;
+
+	decomposition->type = DECOMPOSITION_TYPE_CANONICAL;
+	decomposition->codepoints = decomposition->buf;
+	if (trail_index != 0 && !full) {
+		decomposition->buf[0] = codepoint - trail_index;
+		decomposition->buf[1] = HANGUL_T_BASE + trail_index;
+		decomposition->len = 2;
+	}
+	else {
+		decomposition->buf[0] = HANGUL_L_BASE + syllable_index / HANGUL_N_COUNT;
+		decomposition->buf[1] = HANGUL_V_BASE
+			+ (syllable_index % HANGUL_N_COUNT) / HANGUL_T_COUNT;
+		decomposition->buf[2] = HANGUL_T_BASE + trail_index;
+		decomposition->len = trail_index != 0 ? 3 : 2;
+	}
+	return true;
+}
+
+bool ucd_index_decomposition (const ucd_index * index, unichar codepoint,
+							  ucd_decomposition * decomposition) {
+	if (!ucd_in_subset(codepoint)) return false;
+	if (IS_HANGUL_SYLLABLE(codepoint))
+		return decompose_Hangul_syllable(codepoint, false, decomposition);
+
+	const ucd_record * record = ucd_index_find(index, codepoint);
+	if (record == NULL || record->decomposition_len == 0) return false;
+
+	decomposition->codepoints = index->decompositions + record->decomposition;
+	decomposition->len = record->decomposition_len;
+	decomposition->type = record->decomposition_type;
+	return true;
+}
+
+bool ucd_index_full_decomposition (const ucd_index * index, unichar codepoint,
+								   bool compatibility,
+								   ucd_decomposition * decomposition) {
+	if (!ucd_in_subset(codepoint)) return false;
+	if (IS_HANGUL_SYLLABLE(codepoint))
+		return decompose_Hangul_syllable(codepoint, true, decomposition);
+
+	const ucd_record * record = ucd_index_find(index, codepoint);
+	size_t len = record == NULL ? 0
+		: compatibility ? record->compatibility_len : record->canonical_len;
+	if (len == 0) return false;
+
+	decomposition->codepoints = index->decompositions
+		+ (compatibility ? record->compatibility : record->canonical);
+	decomposition->len = len;
+	decomposition->type = record->decomposition_type;
+	return true;
+}
+
+const char * ucd_index_name (const ucd_index * index, unichar codepoint, char * buf) {
+	if (!CODEPOINT_VALID(codepoint)) return NULL;
+
+	char * name = get_name_by_rule(codepoint);
+	if (name != NULL) {
+		snprintf(buf, UCD_NAME_BUF_LEN, "%s", name);
+		free(name);
+		return buf;
+	}
+
+	const ucd_record * record = ucd_index_find(index, codepoint);
+	// A range whose last line is missing has no name.
+	return record != NULL && record->name != UCD_NO_STRING
+		? index->strings + record->name : NULL;
+}
+
+const char * ucd_index_aliases (const ucd_index * index, unichar codepoint) {
+	const ucd_record * record = ucd_index_find(index, codepoint);
+	return record != NULL && record->aliases != UCD_NO_STRING
+		? index->strings + record->aliases : NULL;
+}
+
+char * ucd_index_get_name (const ucd_index * index, unichar codepoint) {
+	char buf[UCD_NAME_BUF_LEN];
+
+	if (!CODEPOINT_VALID(codepoint)) return NULL;
+
+	const char * name = ucd_index_name(index, codepoint, buf);
+	if (name == NULL) return ASPRINTF("<reserved-%04X>", codepoint);
+
+	const char * aliases = ucd_index_aliases(index, codepoint);
+	return aliases != NULL ? ASPRINTF("%s (%s)", name, aliases)
+		: ASPRINTF("%s", name);
+}
+
+static bool match_name_or_aliases (const ucd_index * index, unichar codepoint,
+								   bool (* match) (const char * name, void * data),
+								   void * data) {
+	char buf[UCD_NAME_BUF_LEN], alias[UCD_NAME_BUF_LEN];
+	const char * name = ucd_index_name(index, codepoint, buf);
+
+	if (name != NULL && match(name, data)) return true;
+
+	const char * aliases = ucd_index_aliases(index, codepoint);
+	while (aliases != NULL) {
+		const char * end = strstr(aliases, ", ");
+		size_t len = end != NULL ? (size_t) (end - aliases) : strlen(aliases);
+		snprintf(alias, sizeof alias, "%.*s", (int) len, aliases);
+		if (match(alias, data)) return true;
+		aliases = end != NULL ? end + 2 : NULL;
+	}
+	return false;
+}
+
+static bool contains_ignoring_case (const char * name, void * text) {
+	size_t len = strlen(text);
+	for (; *name != '\0'; ++name)
+		if (strncasecmp(name, text, len) == 0) return true;
+	return false;
+}
+
+#define HEX_VALUE(c) (isdigit((unsigned char) (c)) ? (c) - '0' : toupper((unsigned char) (c)) - 'A' + 10)
+
+// Adds the code points from low to high whose names contain text, when
+// each name is prefix, the code point in hexadecimal with width digits,
+// and suffix. Each place where the text could start in the name either
+// fits the prefix and suffix without covering any digits, so every name
+// contains it, or fixes the digits it covers, which selects runs of code
+// points that are added without building their names.
+static bool match_pattern_width (codepoint_set * set, const char * prefix, size_t prefix_len,
+								 const char * suffix, size_t suffix_len, int width,
+								 unichar low, unichar high, const char * text) {
+	size_t text_len = strlen(text), name_len = prefix_len + width + suffix_len;
+
+	for (size_t start = 0; start + text_len <= name_len; ++start) {
+		int first_digit = -1, last_digit = -1;
+		unichar digits = 0;
+		bool fits = true;
+
+		for (size_t i = 0; fits && i < text_len; ++i) {
+			size_t pos = start + i;
+			unsigned char c = text[i];
+			if (pos < prefix_len)
+				fits = toupper(c) == toupper((unsigned char) prefix[pos]);
+			else if (pos >= prefix_len + width)
+				fits = toupper(c) == toupper((unsigned char) suffix[pos - prefix_len - width]);
+			else if ((fits = isxdigit(c))) {
+				if (first_digit == -1) first_digit = pos - prefix_len;
+				last_digit = pos - prefix_len;
+				digits = digits << 4 | HEX_VALUE(c);
+			}
+		}
+		if (!fits) continue;
+		if (first_digit == -1) return codepoint_set_add_range(set, low, high);
+
+		// Runs of 16^(digits after the last covered one) code points, one
+		// in each block of 16^(digits from the first covered one).
+		int run_shift = 4 * (width - 1 - last_digit), block_shift = 4 * (width - first_digit);
+		for (unichar block = low >> block_shift; block <= high >> block_shift; ++block) {
+			unichar run_low = block << block_shift | digits << run_shift,
+				run_high = run_low + ((unichar) 1 << run_shift) - 1;
+			if (run_low < low) run_low = low;
+			if (run_high > high) run_high = high;
+			if (run_low <= run_high && !codepoint_set_add_range(set, run_low, run_high))
+				return false;
+		}
+	}
+	return true;
+}
+
+// Like match_pattern_width for a pattern like "CJK UNIFIED IDEOGRAPH-%04X",
+// whose code points have four to six digits.
+static bool match_pattern_names (codepoint_set * set, const char * pattern,
+								 unichar low, unichar high, const char * text) {
+	const char * digits = strstr(pattern, "%04X");
+	if (digits == NULL) return false;
+
+	for (unichar from = low, to; from <= high; from = to + 1) {
+		int width = from > 0xFFFFF ? 6 : from > 0xFFFF ? 5 : 4;
+		to = width == 4 ? 0xFFFF : width == 5 ? 0xFFFFF : 0x10FFFF;
+		if (to > high) to = high;
+		if (!match_pattern_width(set, pattern, digits - pattern, digits + 4, strlen(digits + 4),
+				width, from, to, text))
+			return false;
+	}
+	return true;
+}
+
+// Adds the Hangul syllables from low to high whose names contain text.
+// Syllables with the same lead and vowel are consecutive and differ only in
+// the trailing consonant at the end of the name, so the text is looked for
+// once in the name without it, and otherwise only in the trailing consonant
+// and the few letters before it.
+static bool match_Hangul_syllable_names (codepoint_set * set, unichar low, unichar high,
+										 const char * text) {
+	size_t text_len = strlen(text);
+	char name[UCD_NAME_BUF_LEN], window[UCD_NAME_BUF_LEN];
+	const char * lead, * vowel, * trail;
+
+	for (unichar first = low - (low - HANGUL_S_BASE) % HANGUL_T_COUNT; first <= high;
+			first += HANGUL_T_COUNT) {
+		unichar last = first + HANGUL_T_COUNT - 1;
+		get_Hangul_syllable_jamo(first, &lead, &vowel, &trail);
+		size_t len = snprintf(name, sizeof name, HANGUL_SYLLABLE_PREFIX "%s%s", lead, vowel);
+
+		if (contains_ignoring_case(name, (void *) text)) {
+			if (!codepoint_set_add_range(set, first < low ? low : first, last > high ? high : last))
+				return false;
+			continue;
+		}
+
+		// A match that ends in the trailing consonant starts at most
+		// text_len - 1 letters before it.
+		size_t tail_len = text_len - 1 < len ? text_len - 1 : len;
+		memcpy(window, name + len - tail_len, tail_len);
+		for (unichar codepoint = first + 1; codepoint <= last; ++codepoint) {
+			if (!BETWEEN(codepoint, low, high)) continue;
+			get_Hangul_syllable_jamo(codepoint, &lead, &vowel, &trail);
+			snprintf(window + tail_len, sizeof window - tail_len, "%s", trail);
+			if (contains_ignoring_case(window, (void *) text)
+					&& !codepoint_set_add(set, codepoint))
+				return false;
+		}
+	}
+	return true;
+}
+
+// If text is not NULL, match looks for it ignoring case, and names made by
+// rule for ranges of code points without aliases are matched without being
+// built.
+static codepoint_set * match_names (const ucd_index * index,
+									bool (* match) (const char * name, void * data),
+									void * data, const char * text) {
+	codepoint_set * set = codepoint_set_new();
+	if (set == NULL) return NULL;
+
+	for (size_t i = 0; i < index->record_count; ++i) {
+		const ucd_record * record = &index->records[i];
+		for (unichar codepoint = record->low, last; codepoint <= record->high;
+				codepoint = last + 1) {
+			const char * pattern;
+			bool by_rule = text != NULL && record->aliases == UCD_NO_STRING;
+
+			if (by_rule && IS_HANGUL_SYLLABLE(codepoint)) {
+				last = HANGUL_S_BASE + HANGUL_S_COUNT - 1;
+				if (last > record->high) last = record->high;
+				if (!match_Hangul_syllable_names(set, codepoint, last, text)) goto fail;
+			}
+			else if (by_rule && (pattern = get_name_pattern(codepoint, &last)) != NULL) {
+				if (last > record->high) last = record->high;
+				if (!match_pattern_names(set, pattern, codepoint, last, text)) goto fail;
+			}
+			else {
+				last = codepoint;
+				if (match_name_or_aliases(index, codepoint, match, data)
+						&& !codepoint_set_add(set, codepoint))
+					goto fail;
+			}
+		}
+	}
+
+	// Noncharacters have labels but are not in UnicodeData.txt.
+	for (unichar codepoint = 0xFDD0; codepoint <= 0xFDEF; ++codepoint)
+		if (ucd_in_subset(codepoint)
+				&& match_name_or_aliases(index, codepoint, match, data)
+				&& !codepoint_set_add(set, codepoint))
+			goto fail;
+	for (unichar codepoint = 0xFFFE; codepoint <= 0x10FFFF; codepoint += 0x10000)
+		for (int i = 0; i < 2; ++i)
+			if (ucd_in_subset(codepoint + i)
+					&& match_name_or_aliases(index, codepoint + i, match, data)
+					&& !codepoint_set_add(set, codepoint + i))
+				goto fail;
+
+	return set;
+
+fail:
+	codepoint_set_free(&set);
+	return NULL;
+}
+
+codepoint_set * ucd_index_match_names (const ucd_index * index,
+									   bool (* match) (const char * name, void * data),
+									   void * data) {
+	return match_names(index, match, data, NULL);
+}
+
+codepoint_set * ucd_index_match_names_containing (const ucd_index * index,
+												  const char * text) {
+	return match_names(index, contains_ignoring_case, (void *) text, text);
+}
+
+const codepoint_set * ucd_index_property_set (const ucd_index * index,
+											  enum ucd_property property,
+											  int value) {
+	if (property < 0 || property >= UCD_PROPERTY_COUNT
+			|| !BETWEEN(value, 0, UCD_MAX_PROPERTY_VALUES - 1))
+		return NULL;
+	return index->property_sets[property][value];
+}
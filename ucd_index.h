@@ -0,0 +1,133 @@
+#ifndef UCD_INDEX_H
+#define UCD_INDEX_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "unicodename.h"
+#include "codepoint_set.h"
+
+// In-memory index of UnicodeData.txt and NameAliases.txt, for modes that
+// look up more code points than it is worth rescanning the files for.
+
+#define UCD_NO_STRING UINT32_MAX
+
+// One line of UnicodeData.txt, or a <..., First>/<..., Last> pair of lines.
+typedef struct ucd_record {
+	unichar low, high;
+	uint32_t name;    // offset in strings
+	uint32_t aliases; // offset in strings of aliases joined by ", ", or UCD_NO_STRING
+	uint8_t general_category, bidi_class, combining_class;
+	uint8_t decomposition_type, numeric_type;
+	bool mirrored;
+	// The decomposition mapping in UnicodeData.txt and the full canonical
+	// and compatibility decompositions, as offsets in decompositions.
+	// Lengths are 0 if there is none.
+	uint32_t decomposition, canonical, compatibility;
+	uint8_t decomposition_len, canonical_len, compatibility_len;
+} ucd_record;
+
+// Values of the properties that have a set for each value.
+enum ucd_property {
+	UCD_PROPERTY_GENERAL_CATEGORY,
+	UCD_PROPERTY_BIDI_CLASS,
+	UCD_PROPERTY_COMBINING_CLASS,
+	UCD_PROPERTY_DECOMPOSITION_TYPE,
+	UCD_PROPERTY_NUMERIC_TYPE,
+	UCD_PROPERTY_BIDI_MIRRORED,
+	UCD_PROPERTY_COUNT
+};
+
+#define UCD_MAX_PROPERTY_VALUES 256
+
+typedef struct ucd_index {
+	ucd_record * records;
+	size_t record_count;
+	char * strings;
+	size_t strings_len;
+	unichar * decompositions;
+	size_t decompositions_len;
+	codepoint_set * assigned;
+	codepoint_set * subset; // in a subset build, the code points in it; else NULL
+	// property_sets[property][value]; NULL if no code point has the value.
+	// Unassigned code points have only general category Cn.
+	codepoint_set * property_sets[UCD_PROPERTY_COUNT][UCD_MAX_PROPERTY_VALUES];
+} ucd_index;
+
+// Builds the index by reading both files from the start.
+// Name_Aliases_txt may be NULL.
+ucd_index * ucd_index_load (FILE * Unicode_Data_txt, FILE * Name_Aliases_txt);
+
+void ucd_index_free (ucd_index * * index);
+
+// The record for the code point, or NULL if it is not assigned.
+const ucd_record * ucd_index_find (const ucd_index * index, unichar codepoint);
+
+// Name in the format of get_codepoint_names, with aliases in parentheses.
+// Must be freed. Returns NULL if codepoint is invalid or memory ran out.
+char * ucd_index_get_name (const ucd_index * index, unichar codepoint);
+
+// Name without aliases, pointing into the index or into buf, which must
+// have space for UCD_NAME_BUF_LEN chars. Returns NULL for code points that
+// have no name or label.
+#define UCD_NAME_BUF_LEN 128
+const char * ucd_index_name (const ucd_index * index, unichar codepoint, char * buf);
+
+// Aliases joined by ", ", or NULL.
+const char * ucd_index_aliases (const ucd_index * index, unichar codepoint);
+
+// Calls match with the name and with each alias of every assigned code point
+// and noncharacter, and returns the set of code points for which it returned
+// true. Labels are passed as they are printed, e.g. "<control-0009>".
+codepoint_set * ucd_index_match_names (const ucd_index * index,
+									   bool (* match) (const char * name, void * data),
+									   void * data);
+
+// Like ucd_index_match_names with a match that looks for text ignoring
+// case, but names made by rule for whole ranges, such as CJK ideographs,
+// Hangul syllables and private use, are matched without building each one.
+codepoint_set * ucd_index_match_names_containing (const ucd_index * index,
+												  const char * text);
+
+// Longest full decomposition. The longest in Unicode 11 is that of U+FDFA,
+// 18 code points.
+#define UCD_MAX_DECOMPOSITION_LEN 32
+
+typedef struct ucd_decomposition {
+	const unichar * codepoints; // in the index, or in buf
+	size_t len;
+	int type; // value of UCD_PROPERTY_DECOMPOSITION_TYPE
+	unichar buf[3]; // for Hangul syllables, which are decomposed by rule
+} ucd_decomposition;
+
+// The decomposition mapping of codepoint, one level deep. Returns false if
+// it has none.
+bool ucd_index_decomposition (const ucd_index * index, unichar codepoint,
+							  ucd_decomposition * decomposition);
+
+// The full canonical, or if compatibility is true, compatibility
+// decomposition, with every mapping applied recursively but without
+// canonical reordering. These are computed when the index is loaded.
+// Returns false if codepoint decomposes to itself.
+bool ucd_index_full_decomposition (const ucd_index * index, unichar codepoint,
+								   bool compatibility,
+								   ucd_decomposition * decomposition);
+
+// The tag of a decomposition type in UnicodeData.txt, e.g. "compat", or ""
+// for canonical decompositions.
+const char * ucd_decomposition_tag (int type);
+
+// Property names and values as used in queries, e.g. "gc" and "Lu".
+// Returns -1 if not found.
+enum ucd_property ucd_property_from_name (const char * name);
+int ucd_property_value_from_name (enum ucd_property property, const char * value);
+// Short name of value, or NULL.
+const char * ucd_property_value_name (enum ucd_property property, int value);
+
+// The set of code points that have the value, or NULL if there are none.
+const codepoint_set * ucd_index_property_set (const ucd_index * index,
+											  enum ucd_property property,
+											  int value);
+
+#endif
@@ -0,0 +1,264 @@
+/*
+ *  Holds the loaded Unicode data in snapshots that can be replaced while
+ *  other threads read them.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "common.h"
+#include "ucd_snapshot.h"
+#include "ucd_file.h"
+
+#define FREE_AND_NULL(mem) (free(mem), (mem) = NULL)
+
+#define UNICODE_DATA_PATH  "UnicodeData.txt"
+#define NAME_ALIASES_PATH  "NameAliases.txt"
+#define BLOCKS_PATH        "Blocks.txt"
+#define SCRIPTS_PATH       "Scripts.txt"
+
+// LOADING
+
+// The loaders use static line buffers, so only one snapshot is loaded at
+// a time.
+static pthread_mutex_t load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE * open_in (const char * directory, const char * filename) {
+	size_t len = strlen(directory);
+	char * path = ASPRINTF("%s%s%s", directory,
+		len > 0 && directory[len - 1] != '/' ? "/" : "", filename);
+	if (path == NULL) return NULL;
+
+	FILE * file = ucd_fopen(path);
+	if (file == NULL)
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+	free(path);
+	return file;
+}
+
+static range_table * load_range_table (const char * directory, const char * filename,
+									   const char * default_value) {
+	range_table * table = NULL;
+	FILE * file = open_in(directory, filename);
+	if (file != NULL) {
+		table = range_table_load(file, default_value);
+		fclose(file);
+	}
+	return table;
+}
+
+static void snapshot_free (ucd_snapshot * snapshot) {
+	free(snapshot->directory);
+	ucd_index_free(&snapshot->index);
+	range_table_free(&snapshot->blocks);
+	range_table_free(&snapshot->scripts);
+	free(snapshot);
+}
+
+ucd_snapshot * ucd_snapshot_load (const char * directory, unsigned tables) {
+	ucd_snapshot * snapshot = calloc(1, sizeof *snapshot);
+	MEM_ERR_RETURN_NULL(snapshot);
+	atomic_init(&snapshot->refcount, 1);
+	snapshot->tables = tables;
+
+	if ((snapshot->directory = ASPRINTF("%s", directory)) == NULL) {
+		snapshot_free(snapshot); return NULL;
+	}
+
+	pthread_mutex_lock(&load_lock);
+
+	FILE * Unicode_Data_txt = open_in(directory, UNICODE_DATA_PATH), * Name_Aliases_txt;
+	if (Unicode_Data_txt != NULL) {
+		// No error if NameAliases.txt can't be found.
+		Name_Aliases_txt = open_in(directory, NAME_ALIASES_PATH);
+		snapshot->index = ucd_index_load(Unicode_Data_txt, Name_Aliases_txt);
+		fclose(Unicode_Data_txt);
+		if (Name_Aliases_txt != NULL) fclose(Name_Aliases_txt);
+	}
+
+	if (snapshot->index != NULL) {
+		if (tables & UCD_SNAPSHOT_BLOCKS)
+			snapshot->blocks = load_range_table(directory, BLOCKS_PATH, "No_Block");
+		if (tables & UCD_SNAPSHOT_SCRIPTS)
+			snapshot->scripts = load_range_table(directory, SCRIPTS_PATH, "Unknown");
+	}
+
+	pthread_mutex_unlock(&load_lock);
+
+	if (snapshot->index == NULL) {
+		snapshot_free(snapshot); return NULL;
+	}
+	return snapshot;
+}
+
+void ucd_snapshot_release (ucd_snapshot * * snapshot) {
+	if (*snapshot != NULL && atomic_fetch_sub(&(*snapshot)->refcount, 1) == 1)
+		snapshot_free(*snapshot);
+	*snapshot = NULL;
+}
+
+// END LOADING
+
+// PUBLISHING
+
+// Readers announce themselves in one of two counters, chosen by the parity
+// of generation. A writer swaps the current pointer, then advances
+// generation, so that new readers use the other counter, and waits until
+// the counter of the old generation drops to zero. After that, no reader
+// can still be about to take a reference to the old snapshot.
+static _Atomic(ucd_snapshot *) current = NULL;
+static atomic_uint generation = 0;
+static atomic_uint readers[2];
+
+// Serializes writers; never taken by readers.
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool shut_down = false;
+
+// Reload threads are joinable and listed here until they are joined: at
+// shutdown, or when a later reload starts after they have finished.
+typedef struct reload_thread_entry {
+	pthread_t thread;
+	char * directory; // NULL: the current snapshot's directory
+	atomic_bool done;
+	struct reload_thread_entry * next;
+} reload_thread_entry;
+
+static pthread_mutex_t reloads_lock = PTHREAD_MUTEX_INITIALIZER;
+static reload_thread_entry * reloads = NULL;
+static bool reloads_closed = false; // set by ucd_snapshot_shutdown
+
+ucd_snapshot * ucd_snapshot_acquire (void) {
+	unsigned gen;
+
+	// If a writer advanced the generation while we were registering, it may
+	// not have seen us in the counter, so register in the new one.
+	while (true) {
+		gen = atomic_load(&generation);
+		atomic_fetch_add(&readers[gen & 1], 1);
+		if (atomic_load(&generation) == gen) break;
+		atomic_fetch_sub(&readers[gen & 1], 1);
+	}
+
+	ucd_snapshot * snapshot = atomic_load(&current);
+	if (snapshot != NULL) atomic_fetch_add(&snapshot->refcount, 1);
+
+	atomic_fetch_sub(&readers[gen & 1], 1);
+	return snapshot;
+}
+
+// Waits for the readers that might have loaded the pointer that was just
+// replaced. Called with writer_lock held.
+static void wait_for_readers (void) {
+	unsigned gen = atomic_fetch_add(&generation, 1);
+	while (atomic_load(&readers[gen & 1]) != 0)
+		sched_yield();
+}
+
+static bool swap_current (ucd_snapshot * snapshot, bool shutting_down) {
+	pthread_mutex_lock(&writer_lock);
+	if (shut_down) {
+		pthread_mutex_unlock(&writer_lock);
+		ucd_snapshot_release(&snapshot);
+		return false;
+	}
+	shut_down = shutting_down;
+
+	ucd_snapshot * old = atomic_exchange(&current, snapshot);
+	wait_for_readers();
+	pthread_mutex_unlock(&writer_lock);
+
+	ucd_snapshot_release(&old);
+	return true;
+}
+
+bool ucd_snapshot_publish (ucd_snapshot * snapshot) {
+	return swap_current(snapshot, false);
+}
+
+bool ucd_snapshot_reload (const char * directory) {
+	ucd_snapshot * old = ucd_snapshot_acquire(), * snapshot = NULL;
+	if (directory == NULL && old == NULL) return false;
+
+	snapshot = ucd_snapshot_load(directory != NULL ? directory : old->directory,
+		old != NULL ? old->tables : 0);
+	ucd_snapshot_release(&old);
+
+	return snapshot != NULL && ucd_snapshot_publish(snapshot);
+}
+
+static void * reload_thread (void * data) {
+	reload_thread_entry * entry = data;
+
+	if (ucd_snapshot_reload(entry->directory))
+		fputs("Reloaded the Unicode data.\n", stderr);
+	else
+		fputs("Failed to reload the Unicode data; still using the old data.\n", stderr);
+
+	atomic_store(&entry->done, true);
+	return NULL;
+}
+
+// Joins the reload threads that have finished, or all of them if all is
+// true. Called with reloads_lock held, which reload threads never take.
+static void join_reloads (bool all) {
+	for (reload_thread_entry * * link = &reloads; *link != NULL; ) {
+		reload_thread_entry * entry = *link;
+		if (all || atomic_load(&entry->done)) {
+			pthread_join(entry->thread, NULL);
+			*link = entry->next;
+			free(entry->directory);
+			free(entry);
+		}
+		else
+			link = &entry->next;
+	}
+}
+
+bool ucd_snapshot_reload_async (const char * directory) {
+	bool started = false;
+	int err;
+
+	reload_thread_entry * entry = calloc(1, sizeof *entry);
+	MEM_ERR_RETURN_FALSE(entry);
+	atomic_init(&entry->done, false);
+	if (directory != NULL && (entry->directory = ASPRINTF("%s", directory)) == NULL) {
+		free(entry); return false;
+	}
+
+	// Checking for shutdown and listing the thread under one lock means
+	// that ucd_snapshot_shutdown joins every reload that was started.
+	pthread_mutex_lock(&reloads_lock);
+	join_reloads(false);
+	if (!reloads_closed) {
+		if ((err = pthread_create(&entry->thread, NULL, reload_thread, entry)) == 0) {
+			entry->next = reloads;
+			reloads = entry;
+			started = true;
+		}
+		else {
+			errno = err;
+			perror("Failed to start thread");
+		}
+	}
+	pthread_mutex_unlock(&reloads_lock);
+
+	if (!started) {
+		free(entry->directory);
+		free(entry);
+	}
+	return started;
+}
+
+void ucd_snapshot_shutdown (void) {
+	pthread_mutex_lock(&reloads_lock);
+	reloads_closed = true;
+	join_reloads(true);
+	pthread_mutex_unlock(&reloads_lock);
+
+	swap_current(NULL, true);
+}
+
+// END PUBLISHING
@@ -0,0 +1,62 @@
+#ifndef UCD_SNAPSHOT_H
+#define UCD_SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "ucd_index.h"
+#include "range_table.h"
+
+// Optional tables to load besides UnicodeData.txt and NameAliases.txt.
+enum ucd_snapshot_tables {
+	UCD_SNAPSHOT_BLOCKS  = 1 << 0,
+	UCD_SNAPSHOT_SCRIPTS = 1 << 1
+};
+
+// Everything loaded from one UCD directory. A snapshot is not modified
+// after it is loaded, so it can be read from any number of threads. It is
+// freed when the last reference to it is released.
+typedef struct ucd_snapshot {
+	char * directory;
+	unsigned tables; // enum ucd_snapshot_tables that were requested
+	ucd_index * index;
+	range_table * blocks, * scripts; // NULL if not requested or not found
+	atomic_uint refcount;
+} ucd_snapshot;
+
+// Loads the files in directory. Returns a snapshot with one reference, or
+// NULL if UnicodeData.txt could not be loaded.
+ucd_snapshot * ucd_snapshot_load (const char * directory, unsigned tables);
+
+// Releases a reference and sets *snapshot to NULL.
+void ucd_snapshot_release (ucd_snapshot * * snapshot);
+
+// The current snapshot is shared between threads. Readers never block:
+// ucd_snapshot_acquire only increments counters. Publishing a new snapshot
+// swaps a pointer, waits until no reader can still be taking a reference
+// to the old snapshot, and then releases the old one; readers that hold a
+// reference to it go on using it until they release it.
+
+// Returns a new reference to the current snapshot, or NULL if none has been
+// published.
+ucd_snapshot * ucd_snapshot_acquire (void);
+
+// Makes snapshot current, taking over the caller's reference. Returns false
+// and releases snapshot after ucd_snapshot_shutdown.
+bool ucd_snapshot_publish (ucd_snapshot * snapshot);
+
+// Loads a new snapshot from directory, or from the current snapshot's
+// directory if directory is NULL, with the same tables as the current one,
+// and publishes it.
+bool ucd_snapshot_reload (const char * directory);
+
+// Like ucd_snapshot_reload, but loads on a new thread and returns at once.
+// Returns false if the thread could not be started, or after
+// ucd_snapshot_shutdown.
+bool ucd_snapshot_reload_async (const char * directory);
+
+// Stops new reloads, joins the reload threads, and releases the current
+// snapshot. Nothing can be published afterwards.
+void ucd_snapshot_shutdown (void);
+
+#endif
@@ -9,6 +9,8 @@
 #include "common.h"
 #include "unicodename.h"
 #include "aliases.h"
+#include "range_table.h"
+#include "subset.h"
 
 #define STR_INCLUDES(str1, str2) (strstr((str1), (str2)) != NULL)
 #define FREE0(pointer) ((pointer) != NULL ? free(pointer), (pointer) = NULL : NULL)
@@ -129,18 +131,23 @@ static bool get_data_entry (FILE * data_file,
 							const size_t data_line_len,
 							bool start_over) {
 	static char cur_data_line[BUFSIZ + 1];
-	unichar cur_codepoint;
+	static unichar cur_codepoint;
+	// The last line read may be for a later code point than the one it was
+	// read for, so it is kept for the next call.
+	static bool have_line = false;
 	
 	if (data_line_len > BUFSIZ + 1) {
 		perror("data_line_len should not be greater than BUFSIZ + 1");
 		return NULL;
 	}
 	
-	if (start_over) rewind(data_file);
+	if (start_over) rewind(data_file), have_line = false;
 	
-	while (read_line(data_file, cur_data_line, data_line_len) != EOF
-			&& sscanf(cur_data_line, "%x", &cur_codepoint) == 1
-			&& cur_codepoint < codepoint);
+	while (!have_line || cur_codepoint < codepoint) {
+		have_line = read_line(data_file, cur_data_line, data_line_len) != EOF
+			&& sscanf(cur_data_line, "%x", &cur_codepoint) == 1;
+		if (!have_line) return false;
+	}
 	
 	if (cur_codepoint >= codepoint) {
 		char * first_semicolon = strchr(cur_data_line, ';');
@@ -220,10 +227,18 @@ static char * get_Hangul_syllable_name (const unichar codepoint) {
 		fputs("Hangul Syllable name getting failed.", stderr); return NULL;
 	}
 	
-	return ASPRINTF("HANGUL SYLLABLE %s%s%s",
+	return ASPRINTF(HANGUL_SYLLABLE_PREFIX "%s%s%s",
 		leads[lead_index], vowels[vowel_index], trails[trail_index]);
 }
 
+void get_Hangul_syllable_jamo (const unichar codepoint, const char * * lead,
+							   const char * * vowel, const char * * trail) {
+	int syllable_index = codepoint - SYLLABLE_BASE;
+	*lead  = leads[syllable_index / FINAL_COUNT];
+	*vowel = vowels[(syllable_index % FINAL_COUNT) / TRAIL_COUNT];
+	*trail = trails[syllable_index % TRAIL_COUNT];
+}
+
 // Result is undefined if code point is not a braille pattern (U+2800-U+28FF).
 // The last 8 digits of the codepoint of a braille pattern (minus 0x2800) are
 // a bitmask indicating which of the dots 1 to 8 are colored black (punched).
@@ -343,8 +358,21 @@ static char * print_aliases_list (aliases_list * aliases) {
 	return printed;
 }
 
-static char * get_name_by_rule (const unichar codepoint) {
-	if (IS_BRAILLE_PATTERN(codepoint))
+// The patterns do not overlap the code points that get_name_by_rule names
+// by the other rules.
+const char * get_name_pattern (const unichar codepoint, unichar * high) {
+	if (!ucd_in_subset(codepoint)) return NULL;
+	const name_pattern * patt = find_range(name_patterns, ARR_LEN(name_patterns),
+		sizeof *name_patterns, codepoint);
+	if (patt == NULL) return NULL;
+	*high = patt->high;
+	return patt->format;
+}
+
+char * get_name_by_rule (const unichar codepoint) {
+	if (!ucd_in_subset(codepoint))
+		return ASPRINTF(UCD_OUT_OF_SUBSET_FORMAT, codepoint);
+	else if (IS_BRAILLE_PATTERN(codepoint))
 		return get_braille_pattern_name(codepoint);
 	else if (IS_VARIATION_SELECTOR(codepoint))
 		return get_variation_selector_name(codepoint);
@@ -355,12 +383,10 @@ static char * get_name_by_rule (const unichar codepoint) {
 	else if (IS_NONCHARACTER(codepoint))
 		return ASPRINTF("<noncharacter-%04X>", codepoint);
 	else {
-		for (int i = 0; i < ARR_LEN(name_patterns); ++i) {
-			const name_pattern * patt = &name_patterns[i];
-			if (codepoint < patt->low) break;
-			else if (codepoint <= patt->high)
-				return ASPRINTF(patt->format, codepoint);
-		}
+		const name_pattern * patt = find_range(name_patterns, ARR_LEN(name_patterns),
+			sizeof *name_patterns, codepoint);
+		if (patt != NULL)
+			return ASPRINTF(patt->format, codepoint);
 	}
 	return NULL;
 }
@@ -397,7 +423,7 @@ char * * get_codepoint_names (FILE * Unicode_Data_txt,
 			
 			if (codepoint_name == NULL)
 				codepoint_name = ASPRINTF("<reserved-%04X>", codepoint);
-			else {
+			else if (ucd_in_subset(codepoint)) {
 				char * aliases = print_aliases_list(
 					get_aliases(Name_Aliases_txt, codepoint, scanned_aliases));
 				scanned_aliases = true;
@@ -1,4 +1,8 @@
+#ifndef UNICODENAME_H
+#define UNICODENAME_H
+
 // #include <ctype.h>
+#include <stdio.h> // for FILE
 #include <stdint.h> // for uint32_t
 
 typedef uint32_t unichar;
@@ -24,10 +28,30 @@ enum Unicode_data_fields {
 
 size_t read_line (FILE * f, char * const buf, const size_t len);
 
+// Name or label of code point whose name is derived by rule rather than
+// listed in UnicodeData.txt, or NULL. Must be freed.
+char * get_name_by_rule (const unichar codepoint);
+
+// If the name of code point is made by a pattern of a prefix, the code
+// point in hexadecimal with at least four digits (%04X), and a suffix, as
+// in "CJK UNIFIED IDEOGRAPH-%04X" and "<private-use-%04X>", returns the
+// pattern and sets *high to the last code point it is used for.
+const char * get_name_pattern (const unichar codepoint, unichar * high);
+
+#define HANGUL_SYLLABLE_PREFIX "HANGUL SYLLABLE "
+
+// Sets the short names of the jamo that follow HANGUL_SYLLABLE_PREFIX in
+// the name of a Hangul syllable (U+AC00-U+D7A3); trail may be "".
+// Result is undefined for other code points.
+void get_Hangul_syllable_jamo (const unichar codepoint, const char * * lead,
+							   const char * * vowel, const char * * trail);
+
 void free_codepoint_names(char * * codepoint_names, size_t count);
 
 char * * get_codepoint_names (FILE * Unicode_Data_txt,
 							  FILE * Name_Aliases_txt,
 							  unichar * const codepoints,
 							  const size_t count,
-							  char * * codepoint_names);
\ No newline at end of file
+							  char * * codepoint_names);
+
+#endif
\ No newline at end of file
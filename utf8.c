@@ -0,0 +1,96 @@
+#include <string.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "utf8.h"
+
+#define HIGH_BITS_64 UINT64_C(0x8080808080808080)
+
+#define IS_CONTINUATION(byte) (((byte) & 0xC0) == 0x80)
+
+size_t utf8_ascii_prefix (const unsigned char * buf, size_t len) {
+	size_t i = 0;
+
+#ifdef __SSE2__
+	for (; i + 32 <= len; i += 32) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (buf + i)),
+			b = _mm_loadu_si128((const __m128i *) (buf + i + 16));
+		if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0) break;
+	}
+	for (; i + 16 <= len; i += 16) {
+		int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) (buf + i)));
+		if (mask != 0) return i + __builtin_ctz(mask);
+	}
+#endif
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t word;
+		memcpy(&word, buf + i, sizeof word);
+		if (word & HIGH_BITS_64) break;
+	}
+	while (i < len && buf[i] < 0x80) ++i;
+
+	return i;
+}
+
+size_t utf8_decode (const unsigned char * buf, size_t len, unichar * codepoint) {
+	unichar cp, min;
+	size_t seq_len;
+	unsigned char lead = buf[0];
+
+	if (lead < 0x80) {
+		*codepoint = lead; return 1;
+	}
+	else if (lead >= 0xC2 && lead <= 0xDF) cp = lead & 0x1F, seq_len = 2, min = 0x80;
+	else if (lead >= 0xE0 && lead <= 0xEF) cp = lead & 0x0F, seq_len = 3, min = 0x800;
+	else if (lead >= 0xF0 && lead <= 0xF4) cp = lead & 0x07, seq_len = 4, min = 0x10000;
+	else {
+		*codepoint = UTF8_INVALID; return 1;
+	}
+
+	for (size_t i = 1; i < seq_len; ++i) {
+		if (i == len) return 0;
+		if (!IS_CONTINUATION(buf[i])) {
+			*codepoint = UTF8_INVALID; return 1;
+		}
+		cp = cp << 6 | (buf[i] & 0x3F);
+	}
+
+	if (cp < min || !CODEPOINT_VALID(cp) || BETWEEN(cp, 0xD800, 0xDFFF)) {
+		*codepoint = UTF8_INVALID; return 1;
+	}
+
+	*codepoint = cp;
+	return seq_len;
+}
+
+size_t utf8_encode (unichar codepoint, unsigned char * buf) {
+	if (codepoint < 0x80) {
+		buf[0] = codepoint;
+		return 1;
+	}
+	else if (codepoint < 0x800) {
+		buf[0] = 0xC0 | codepoint >> 6;
+		buf[1] = 0x80 | (codepoint & 0x3F);
+		return 2;
+	}
+	else if (codepoint < 0x10000) {
+		if (BETWEEN(codepoint, 0xD800, 0xDFFF)) return 0;
+		buf[0] = 0xE0 | codepoint >> 12;
+		buf[1] = 0x80 | (codepoint >> 6 & 0x3F);
+		buf[2] = 0x80 | (codepoint & 0x3F);
+		return 3;
+	}
+	else if (CODEPOINT_VALID(codepoint)) {
+		buf[0] = 0xF0 | codepoint >> 18;
+		buf[1] = 0x80 | (codepoint >> 12 & 0x3F);
+		buf[2] = 0x80 | (codepoint >> 6 & 0x3F);
+		buf[3] = 0x80 | (codepoint & 0x3F);
+		return 4;
+	}
+	return 0;
+}
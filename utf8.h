@@ -0,0 +1,28 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+
+#include "unicodename.h"
+
+// Returned in codepoint by utf8_decode for a byte that does not begin a
+// valid sequence. The byte is consumed.
+#define UTF8_INVALID ((unichar) -1)
+
+#define UTF8_MAX_LEN 4
+
+// Length of the prefix of buf that is ASCII. Uses SSE2 where available.
+size_t utf8_ascii_prefix (const unsigned char * buf, size_t len);
+
+// Decodes the sequence at the start of buf into codepoint, rejecting
+// overlong forms, surrogates, and values over U+10FFFF.
+// Returns the number of bytes consumed, or 0 if buf ends in the middle of
+// a sequence that may still turn out valid.
+size_t utf8_decode (const unsigned char * buf, size_t len, unichar * codepoint);
+
+// Writes the encoding of codepoint to buf, which must have space for
+// UTF8_MAX_LEN bytes. Returns the number of bytes written, or 0 if codepoint
+// is a surrogate or out of range.
+size_t utf8_encode (unichar codepoint, unsigned char * buf);
+
+#endif